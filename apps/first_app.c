@@ -217,8 +217,7 @@ void FirstApp::run() {
 
       int shader_count = myimgui.get_shader_count();
       if (shader_count == 0) {
-         no_filter.instant_dispatch(initial_img.Width, initial_img.Height,
-                                    initial_img.Channels,
+         no_filter.instant_dispatch(initial_img.Width, initial_img.Height, 1,
                                     DescriptorSetInOut);
       }
       if (shader_count > 0) {
@@ -226,14 +225,13 @@ void FirstApp::run() {
              myimgui.get_first_shader() ? blur_filter : edge_detect;
          VkDescriptorSet &DescriptorSet =
              shader_count == 1 ? DescriptorSetInOut : DescriptorSetInBuf;
-         first.instant_dispatch(initial_img.Width, initial_img.Height,
-                                initial_img.Channels, DescriptorSet);
+         first.instant_dispatch(initial_img.Width, initial_img.Height, 1,
+                                DescriptorSet);
       }
       if (shader_count > 1) {
          ComputeSystem &second =
              myimgui.get_second_shader() ? blur_filter : edge_detect;
-         second.instant_dispatch(initial_img.Width, initial_img.Height,
-                                 initial_img.Channels,
+         second.instant_dispatch(initial_img.Width, initial_img.Height, 1,
                                  DescriptorSetBufOut);
       }
    }
@@ -6,19 +6,27 @@
 // std
 #include <imgui.h>
 
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <future>
 #include <glm/common.hpp>
 #include <glm/ext/scalar_constants.hpp>
 #include <glm/ext/vector_float3.hpp>
 #include <glm/fwd.hpp>
 #include <glm/geometric.hpp>
 #include <glm/trigonometric.hpp>
+#include <iostream>
 #include <memory>
+#include <numeric>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "../lve/lve_buffer.hpp"
@@ -26,7 +34,10 @@
 #include "../lve/lve_descriptors.hpp"
 #include "../lve/lve_swap_chain.hpp"
 #include "../movement_controllers/water_movement_controller.hpp"
+#include "../systems/cpu_ocean.hpp"
+#include "../systems/cpu_ocean_upload.hpp"
 #include "../systems/gui_system.hpp"
+#include "../systems/ocean_readback.hpp"
 #include "../systems/water_render_system.hpp"
 #include "lve/lve_pipeline.hpp"
 #include "second_app_frame_info.hpp"
@@ -40,7 +51,29 @@
 
 namespace lve {
 
-SecondApp::SecondApp(size_t n) : N(n) {
+SecondApp::SecondApp(size_t n, std::vector<float> lengthScales,
+                     std::vector<size_t> cascadeSizes,
+                     SimulationPrecision precision, bool compactOutputs,
+                     uint32_t outputs, size_t spectrumCacheMiB,
+                     bool hybrid, uint32_t readbackTexels)
+    : N(n),
+      lengthScales(lengthScales),
+      cascadeSizes(cascadeSizes),
+      precision(precision),
+      compactOutputs(compactOutputs),
+      outputs(outputs),
+      spectrumCacheMiB(spectrumCacheMiB),
+      hybrid(hybrid),
+      readbackTexels(readbackTexels) {
+   // The FFT needs powers of two, and past 8192 a single cascade would
+   // not fit in any device's memory.
+   constexpr size_t maxN = 8192;
+   if (N < 16 || N > maxN || (N & (N - 1)) != 0 ||
+       N > lveDevice.properties.limits.maxImageDimension2D) {
+      throw std::runtime_error(
+          "N must be a power of two from 16 to 8192 within the device's "
+          "image size limit");
+   }
    loadGameObjects();
 }
 
@@ -55,6 +88,16 @@ float jonswap_peak_features(float g, float fetch, float windSpeed) {
    return 22 * std::pow(windSpeed * fetch / g / g, -0.33f);
 }
 
+// 64 bit FNV-1a, chained through hash.
+uint64_t fnv1a(const void *data, size_t bytes,
+               uint64_t hash = 14695981039346656037ull) {
+   const unsigned char *byte = static_cast<const unsigned char *>(data);
+   for (size_t i = 0; i < bytes; ++i) {
+      hash = (hash ^ byte[i]) * 1099511628211ull;
+   }
+   return hash;
+}
+
 void SecondApp::run() {
    std::vector<std::unique_ptr<LveBuffer>> uboBuffers(
        LveSwapChain::MAX_FRAMES_IN_FLIGHT);
@@ -98,71 +141,16 @@ void SecondApp::run() {
 
    size_t pipeline = 0;
 
-   size_t logN = std::log2(N);
-
-   MyTextureData buterfly(logN, N, 4, lveDevice,
-                          VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData H0K(N, N, 2, lveDevice, VK_FORMAT_R16G16_SFLOAT);
-   MyTextureData WavesData0(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData H00(N, N, 4, lveDevice, VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData WavesData1(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData H01(N, N, 4, lveDevice, VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData WavesData2(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData H02(N, N, 4, lveDevice, VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData WavesData3(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData H03(N, N, 4, lveDevice, VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DxDzDyDxz0(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DyxDyzDxxDzz0(N, N, 4, lveDevice,
-                               VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DxDzDyDxz1(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DyxDyzDxxDzz1(N, N, 4, lveDevice,
-                               VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DxDzDyDxz2(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DyxDyzDxxDzz2(N, N, 4, lveDevice,
-                               VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DxDzDyDxz3(N, N, 4, lveDevice,
-                            VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData DyxDyzDxxDzz3(N, N, 4, lveDevice,
-                               VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong1_0(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong2_0(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong1_1(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong2_1(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong1_2(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong2_2(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong1_3(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData ping_pong2_3(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Displacement_Turbulence0(N, N, 4, lveDevice,
-                                          VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Derivatives0(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Displacement_Turbulence1(N, N, 4, lveDevice,
-                                          VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Derivatives1(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Displacement_Turbulence2(N, N, 4, lveDevice,
-                                          VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Derivatives2(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Displacement_Turbulence3(N, N, 4, lveDevice,
-                                          VK_FORMAT_R16G16B16A16_SFLOAT);
-   MyTextureData Derivatives3(N, N, 4, lveDevice,
-                              VK_FORMAT_R16G16B16A16_SFLOAT);
+   // The per step cascade masks are 32 bits wide, and the held states
+   // take two layers per cascade.
+   uint32_t cascades = lengthScales.size();
+   if (cascades == 0 || cascades > 32 ||
+       2 * cascades > lveDevice.properties.limits.maxImageArrayLayers) {
+      throw std::runtime_error("unsupported number of cascades");
+   }
+   if (!cascadeSizes.empty() && cascadeSizes.size() != cascades) {
+      throw std::runtime_error("one size is needed per cascade");
+   }
 
    typedef struct {
       glm::float32 LengthScale;
@@ -171,73 +159,518 @@ void SecondApp::run() {
       glm::float32 GravityAcceleration;
       glm::float32 Depth;
       glm::uint Size;
+      // Size group of the cascade and its layer in the group's textures.
+      glm::uint Group;
+      glm::uint Layer;
+      // The outputs hold (value - bias) / scale, per channel.
+      glm::vec4 DisplacementScale;
+      glm::vec4 DisplacementBias;
+      glm::vec4 DerivativesScale;
+      glm::vec4 DerivativesBias;
    } comp_ubo;
 
-   std::unique_ptr<LveDescriptorSetLayout> gen_butterfly_desc_layout =
-       LveDescriptorSetLayout::Builder(lveDevice)
-           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                       VK_SHADER_STAGE_COMPUTE_BIT)
-           .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                       VK_SHADER_STAGE_COMPUTE_BIT)
-           .build();
+   // Each cascade covers the wave numbers between its own boundary and
+   // the next cascade's one.
+   std::vector<comp_ubo> comp_buf(cascades);
+   for (uint32_t i = 0; i < cascades; ++i) {
+      comp_buf[i].LengthScale = lengthScales[i];
+      comp_buf[i].GravityAcceleration = 9.81;
+      comp_buf[i].Depth = 500.0;
+      comp_buf[i].CutoffLow =
+          i == 0 ? 0.0001f
+                 : glm::pi<float>() / comp_buf[i].LengthScale * 6.f;
+      // Set by fitOutputRanges for compact outputs.
+      comp_buf[i].DisplacementScale = glm::vec4(1.f);
+      comp_buf[i].DisplacementBias = glm::vec4(0.f);
+      comp_buf[i].DerivativesScale = glm::vec4(1.f);
+      comp_buf[i].DerivativesBias = glm::vec4(0.f);
+   }
+   for (uint32_t i = 0; i < cascades; ++i) {
+      comp_buf[i].CutoffHigh =
+          i + 1 < cascades ? comp_buf[i + 1].CutoffLow : 9999.0;
+   }
 
-   ComputeSystem gen_butterfly{
-       lveDevice,
-       {gen_butterfly_desc_layout->getDescriptorSetLayout()},
-       "obj/shaders/gen_buterfly.comp.spv"};
+   // init_spectrum leaves every texel with |k| > CutoffHigh at zero, so
+   // the spectrum of a cascade only spans radius texels around the
+   // center on each axis. Without explicit sizes a cascade gets at least
+   // four texels per period of its shortest wave, up to N.
+   std::vector<float> radius(cascades);
+   for (uint32_t i = 0; i < cascades; ++i) {
+      float deltaK = 2 * glm::pi<float>() / comp_buf[i].LengthScale;
+      radius[i] = std::ceil(comp_buf[i].CutoffHigh / deltaK);
+      uint32_t size = N;
+      if (!cascadeSizes.empty()) {
+         size = cascadeSizes[i];
+      } else if (4 * radius[i] < N) {
+         size = 16;
+         while (size < 4 * radius[i]) size *= 2;
+      }
+      if (size < 16 || size > N || (size & (size - 1)) != 0) {
+         throw std::runtime_error(
+             "cascade sizes must be powers of two from 16 to N");
+      }
+      comp_buf[i].Size = size;
+   }
+
+   // Every cascade lives in a layer of its group's array textures, so
+   // each pass of the simulation is a single dispatch per group with one
+   // workgroup layer per cascade. The water shaders index a sampler
+   // array by group, mirrored there as CASCADE_GROUPS.
+   constexpr uint32_t maxCascadeGroups = 4;
+   // Automatic sizes past that many are merged: the cascades of one size
+   // are raised to the next larger one, whichever adds the fewest
+   // texels, so none gets fewer texels per period. Explicit sizes are
+   // refused when grouping them.
+   while (cascadeSizes.empty()) {
+      std::vector<uint32_t> sizes;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         sizes.push_back(comp_buf[i].Size);
+      }
+      std::sort(sizes.begin(), sizes.end());
+      sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+      if (sizes.size() <= maxCascadeGroups) break;
+      size_t merged = 0;
+      uint64_t mergedTexels = ~uint64_t(0);
+      for (size_t s = 0; s + 1 < sizes.size(); ++s) {
+         uint64_t texels = 0;
+         for (uint32_t i = 0; i < cascades; ++i) {
+            if (comp_buf[i].Size != sizes[s]) continue;
+            texels += uint64_t(sizes[s + 1]) * sizes[s + 1] -
+                      uint64_t(sizes[s]) * sizes[s];
+         }
+         if (texels < mergedTexels) {
+            merged = s;
+            mergedTexels = texels;
+         }
+      }
+      std::cout << "too many different cascade sizes, cascades of "
+                << sizes[merged] << " raised to " << sizes[merged + 1]
+                << '\n';
+      for (uint32_t i = 0; i < cascades; ++i) {
+         if (comp_buf[i].Size == sizes[merged]) {
+            comp_buf[i].Size = sizes[merged + 1];
+         }
+      }
+   }
+   // History of simulation outputs, one slot per step. The water
+   // shaders blend the two latest finished steps while the compute queue
+   // writes the next ones, at most simHistory - 2 per frame.
+   constexpr size_t simHistory = 4;
+   // Most WavesData and H0 sets kept per group. Two let a rebuild run
+   // without stalling the steps, the rest cache earlier spectra.
+   constexpr size_t maxSpectrumSets = 8;
+   struct cascade_group {
+      uint32_t size;
+      uint32_t logSize;
+      // Cascade of each layer. first is where the group's entries start
+      // in the per cascade buffers laid out by group.
+      std::vector<uint32_t> cascades;
+      uint32_t first;
+      // The ones shown in the GUI are shared between the compute and
+      // graphics queues. WavesData and H0 come in spectrumSets sets, the
+      // steps read the front one while a rebuild writes another, and the
+      // rest cache earlier spectra.
+      std::unique_ptr<MyTextureData> H0K;
+      std::unique_ptr<MyTextureData> WavesData[maxSpectrumSets];
+      std::unique_ptr<MyTextureData> H0[maxSpectrumSets];
+      // The spectrum a sea state transition blends from.
+      std::unique_ptr<MyTextureData> H0Blend;
+      std::unique_ptr<MyTextureData> DxDzDyDxz;
+      std::unique_ptr<MyTextureData> DyxDyzDxxDzz;
+      std::unique_ptr<MyTextureData> ping_pong1;
+      std::unique_ptr<MyTextureData> ping_pong2;
+      std::unique_ptr<MyTextureData> Displacement_Turbulence[simHistory];
+      std::unique_ptr<MyTextureData> Derivatives[simHistory];
+      // Turbulence decays from one step to the next. It stays on the
+      // compute queue, so the slots above can be handed to graphics.
+      std::unique_ptr<MyTextureData> Turbulence;
+      // Phasor evolution state, exp(i omega t) and the per tick
+      // rotation exp(i omega tick) of every wave. fp32, it accumulates
+      // for as long as the simulation runs.
+      std::unique_ptr<MyTextureData> Phase;
+      // The two latest updates of every cascade updated less often than
+      // every step, in layers 2 * layer and 2 * layer + 1.
+      std::unique_ptr<MyTextureData> HeldDisplacement_Turbulence;
+      std::unique_ptr<MyTextureData> HeldDerivatives;
+      // The group's comp_ubo and spectrum_band entries, by layer, and
+      // the output scales each held layer was packed with.
+      std::unique_ptr<LveBuffer> compBuffer;
+      std::unique_ptr<LveBuffer> heldScaleBuffer;
+      std::unique_ptr<LveBuffer> bandBuffer;
+      // exp(-2 pi i k / size) for k < size / 2, shared by every stage of
+      // the FFT.
+      std::unique_ptr<LveBuffer> twiddleBuffer;
+      // The ones that touch WavesData or H0, indexed by spectrum set.
+      VkDescriptorSet init_spec_desc_set[maxSpectrumSets];
+      VkDescriptorSet conj_spec_desc_set[maxSpectrumSets];
+      VkDescriptorSet range_desc_set[maxSpectrumSets];
+      VkDescriptorSet blend_spec_desc_set[maxSpectrumSets];
+      // Indexed by [ping pong parity][field], parity 0 reads the
+      // spectrum textures and parity 1 reads the ping pong ones.
+      VkDescriptorSet butterfly_desc_sets[2][2];
+      VkDescriptorSet perm_inv_desc_sets[2];
+      VkDescriptorSet timed_spec_desc_set[maxSpectrumSets];
+      VkDescriptorSet text_merg_desc_set[simHistory];
+      VkDescriptorSet fft_merg_desc_set[simHistory];
+      VkDescriptorSet interp_desc_set[simHistory];
+      VkDescriptorSet error_desc_set[maxSpectrumSets][simHistory];
+      VkDescriptorSet readback_desc_set[simHistory];
+      bool sharedFFT;
+      bool fusedAvailable;
+      // Butterflies each invocation of the shared memory FFT runs per
+      // stage, more than one when half a row exceeds the workgroup size.
+      uint32_t butterflies;
+      std::unique_ptr<ComputeSystem> h_fft;
+      std::unique_ptr<ComputeSystem> v_fft;
+      std::unique_ptr<ComputeSystem> v_fft_merg;
+      // Without the shared memory FFT, radixLog stages per pass split
+      // between radixLanes lanes, the leftover stages one per pass.
+      uint32_t radixLog;
+      uint32_t radixLanes;
+      std::unique_ptr<ComputeSystem> h_radix;
+      std::unique_ptr<ComputeSystem> v_radix;
+   };
 
-   VkDescriptorImageInfo butterflyImageInfo = {
-       .imageView = buterfly.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+   // Formats of the intermediate textures for the chosen precision,
+   // matching the shader variants built for it. The outputs have their
+   // own formats, picked below.
+   bool fp32Spectrum = precision == SimulationPrecision::Full;
+   bool fp32Scratch = precision != SimulationPrecision::Half;
+   const VkFormat h0kFormat =
+       fp32Spectrum ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R16G16_SFLOAT;
+   const VkFormat spectrumFormat = fp32Spectrum
+                                       ? VK_FORMAT_R32G32B32A32_SFLOAT
+                                       : VK_FORMAT_R16G16B16A16_SFLOAT;
+   const VkFormat scratchFormat = fp32Scratch
+                                      ? VK_FORMAT_R32G32B32A32_SFLOAT
+                                      : VK_FORMAT_R16G16B16A16_SFLOAT;
+   const VkDeviceSize spectrumBytes = fp32Spectrum ? 16 : 8;
+   const VkDeviceSize scratchBytes = fp32Scratch ? 16 : 8;
+   const char *precisionSuffix[] = {"", "_mixed", "_full"};
+   const char *precisionNames[] = {"fp16", "mixed", "fp32"};
+   auto simulationShader = [&](const std::string &name) {
+      return "obj/shaders/" + name + precisionSuffix[size_t(precision)] +
+             ".comp.spv";
    };
 
-   VkDescriptorSet buterflyDescriptorSet = {};
+   // Compact outputs need both formats as storage images that can be
+   // filtered, and the shader side support for rgb10_a2.
+   bool compact = compactOutputs;
+   if (compact) {
+      const VkFormatFeatureFlags needed =
+          VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+      for (VkFormat format : {VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+                              VK_FORMAT_R8G8B8A8_SNORM}) {
+         VkFormatProperties formatProperties;
+         vkGetPhysicalDeviceFormatProperties(lveDevice.physical_device(),
+                                             format, &formatProperties);
+         if ((formatProperties.optimalTilingFeatures & needed) != needed) {
+            compact = false;
+         }
+      }
+      if (!lveDevice.storageImageExtendedFormats) compact = false;
+      if (!compact) {
+         std::cout << "compact outputs not supported, using fp16\n";
+      }
+   }
+   // Displacement goes to unorm 10 bit channels and the derivatives to
+   // snorm 8 bit ones. The turbulence copy in the alpha channel keeps 2
+   // bits, the water shaders do not sample it.
+   const VkFormat displacementFormat =
+       compact ? VK_FORMAT_A2B10G10R10_UNORM_PACK32
+               : VK_FORMAT_R16G16B16A16_SFLOAT;
+   const VkFormat derivativesFormat = compact
+                                          ? VK_FORMAT_R8G8B8A8_SNORM
+                                          : VK_FORMAT_R16G16B16A16_SFLOAT;
+   const VkDeviceSize outputBytes = compact ? 4 : 8;
+   // The passes that write or read the outputs.
+   auto outputShader = [&](const std::string &name) {
+      return "obj/shaders/" + name + precisionSuffix[size_t(precision)] +
+             (compact ? "_compact" : "") + ".comp.spv";
+   };
+
+   // Fields left out are never written, their textures shrink to a
+   // single zero texel per layer, which the water shaders sample as flat
+   // slopes wherever they look.
+   uint32_t features = outputs;
+   if ((features & OutputTurbulence) && !(features & OutputDerivatives)) {
+      std::cout << "turbulence needs the derivatives, simulating them\n";
+      features |= OutputDerivatives;
+   }
+   const bool derivatives = features & OutputDerivatives;
+   const bool turbulence = features & OutputTurbulence;
+   // Fields the FFT runs on.
+   const size_t fields = derivatives ? 2 : 1;
+
+   // Device memory per texel of a cascade: H0K half a spectrum texel,
+   // two sets of WavesData and H0 and H0Blend a spectrum texel each,
+   // the spectrum and ping pong texture of each field a scratch texel
+   // each, simHistory outputs and two held copies of each field,
+   // Turbulence 4 and Phase 16. The host visible buffers hold each
+   // cascade's parameters, band, output ranges and error samples, and
+   // the twiddles of each size.
+   const VkDeviceSize cascadeTexelBytes =
+       spectrumBytes / 2 + 5 * spectrumBytes + fields * 2 * scratchBytes +
+       (simHistory + 2) * fields * outputBytes + (turbulence ? 4 : 0) +
+       16;
+   auto deviceBytes = [&]() {
+      VkDeviceSize bytes = 0;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         bytes += VkDeviceSize(comp_buf[i].Size) * comp_buf[i].Size *
+                  cascadeTexelBytes;
+      }
+      return bytes;
+   };
+   // Displacement samples per cascade checked against the fp32
+   // reference when the comparison is on, as SAMPLES in
+   // precision_error.comp.
+   constexpr uint32_t errorSamples = 64;
+   // Texels per side of each cascade's readback, see readback.comp, its
+   // size halved until within readbackTexels.
+   auto readbackSize = [&](uint32_t i) {
+      uint32_t size = comp_buf[i].Size;
+      while (size > std::max(readbackTexels, 1u)) size /= 2;
+      return size;
+   };
+   auto hostBytes = [&]() {
+      VkDeviceSize bytes = 0;
+      std::vector<uint32_t> sizes;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         bytes += (simHistory + 1) * sizeof(comp_ubo) + sizeof(glm::uvec2) +
+                  2 * sizeof(glm::vec4) +
+                  simHistory * errorSamples * sizeof(glm::vec4);
+         if (readbackTexels != 0) {
+            bytes += simHistory * readbackSize(i) * readbackSize(i) *
+                     sizeof(glm::vec4);
+         }
+         if (std::find(sizes.begin(), sizes.end(), comp_buf[i].Size) ==
+             sizes.end()) {
+            sizes.push_back(comp_buf[i].Size);
+            bytes += comp_buf[i].Size / 2 * sizeof(glm::vec2);
+         }
+      }
+      return bytes;
+   };
+   // Leave a fifth of the device memory for the swapchain, the mesh and
+   // everything else. Automatically sized cascades are halved, largest
+   // first, until they fit; explicit sizes are refused.
+   constexpr VkDeviceSize MiB = 1 << 20;
+   VkDeviceSize deviceBudget =
+       lveDevice.memoryBudget(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) / 5 * 4;
+   while (deviceBytes() > deviceBudget) {
+      uint32_t largest = 0;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         largest = std::max(largest, comp_buf[i].Size);
+      }
+      if (!cascadeSizes.empty() || largest <= 16) {
+         throw std::runtime_error(
+             "the simulation needs " + std::to_string(deviceBytes() / MiB) +
+             " MiB of device memory, only " +
+             std::to_string(deviceBudget / MiB) + " MiB are available");
+      }
+      std::cout << "not enough device memory, cascades of " << largest
+                << " reduced to " << largest / 2 << '\n';
+      for (uint32_t i = 0; i < cascades; ++i) {
+         if (comp_buf[i].Size == largest) comp_buf[i].Size /= 2;
+      }
+   }
+   VkDeviceSize hostBudget =
+       lveDevice.memoryBudget(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   if (hostBytes() > hostBudget) {
+      throw std::runtime_error("not enough host visible memory");
+   }
+   // Sets past the two a rebuild needs, while every set together fits in
+   // spectrumCacheMiB and the rest of the budget.
+   VkDeviceSize spectrumSetBytes = 0;
+   for (uint32_t i = 0; i < cascades; ++i) {
+      spectrumSetBytes += VkDeviceSize(comp_buf[i].Size) *
+                          comp_buf[i].Size * 2 * spectrumBytes;
+   }
+   size_t spectrumSets = 2;
+   while (spectrumSets < maxSpectrumSets &&
+          (spectrumSets + 1) * spectrumSetBytes <=
+              spectrumCacheMiB * MiB &&
+          deviceBytes() + (spectrumSets - 1) * spectrumSetBytes <=
+              deviceBudget) {
+      ++spectrumSets;
+   }
+   std::cout << "simulation memory, " << precisionNames[size_t(precision)]
+             << " precision, " << (compact ? "compact" : "fp16")
+             << " outputs, "
+             << (turbulence ? "foam" : derivatives ? "slopes" : "height")
+             << ": "
+             << (deviceBytes() + (spectrumSets - 2) * spectrumSetBytes) /
+                    MiB
+             << " MiB device local (" << deviceBudget / MiB
+             << " MiB usable) with " << spectrumSets
+             << " spectrum sets, " << hostBytes() / 1024
+             << " KiB host visible\n";
+
+   std::vector<cascade_group> groups;
+   for (uint32_t i = 0; i < cascades; ++i) {
+      size_t g = 0;
+      while (g < groups.size() && groups[g].size != comp_buf[i].Size) ++g;
+      if (g == groups.size()) {
+         if (g == maxCascadeGroups) {
+            throw std::runtime_error("too many different cascade sizes");
+         }
+         groups.emplace_back();
+         groups[g].size = comp_buf[i].Size;
+         groups[g].logSize = std::log2(comp_buf[i].Size);
+      }
+      comp_buf[i].Group = g;
+      comp_buf[i].Layer = groups[g].cascades.size();
+      groups[g].cascades.push_back(i);
+   }
+   for (size_t g = 0, first = 0; g < groups.size(); ++g) {
+      groups[g].first = first;
+      first += groups[g].cascades.size();
+   }
+   // Position of a cascade in the buffers laid out by group.
+   auto packed = [&](uint32_t i) {
+      return groups[comp_buf[i].Group].first + comp_buf[i].Layer;
+   };
+   // Turns a mask with a bit per cascade into one with a bit per layer
+   // of the group.
+   auto layerMask = [](const cascade_group &group, uint32_t mask) {
+      uint32_t layers = 0;
+      for (uint32_t layer = 0; layer < group.cascades.size(); ++layer) {
+         if (mask & (1u << group.cascades[layer])) layers |= 1u << layer;
+      }
+      return layers;
+   };
+
+   for (cascade_group &group : groups) {
+      size_t n = group.size;
+      size_t dn = derivatives ? n : 1;
+      size_t tn = turbulence ? n : 1;
+      size_t layers = group.cascades.size();
+      group.H0K = std::make_unique<MyTextureData>(
+          n, n, spectrumBytes / 4, lveDevice, h0kFormat, layers, true);
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         group.WavesData[set] = std::make_unique<MyTextureData>(
+             n, n, spectrumBytes / 2, lveDevice, spectrumFormat, layers,
+             true);
+         group.H0[set] = std::make_unique<MyTextureData>(
+             n, n, spectrumBytes / 2, lveDevice, spectrumFormat, layers,
+             true);
+      }
+      group.H0Blend = std::make_unique<MyTextureData>(
+          n, n, spectrumBytes / 2, lveDevice, spectrumFormat, layers);
+      group.DxDzDyDxz = std::make_unique<MyTextureData>(
+          n, n, scratchBytes / 2, lveDevice, scratchFormat, layers);
+      group.DyxDyzDxxDzz = std::make_unique<MyTextureData>(
+          dn, dn, scratchBytes / 2, lveDevice, scratchFormat, layers);
+      group.ping_pong1 = std::make_unique<MyTextureData>(
+          n, n, scratchBytes / 2, lveDevice, scratchFormat, layers);
+      group.ping_pong2 = std::make_unique<MyTextureData>(
+          dn, dn, scratchBytes / 2, lveDevice, scratchFormat, layers);
+      for (size_t slot = 0; slot < simHistory; ++slot) {
+         group.Displacement_Turbulence[slot] =
+             std::make_unique<MyTextureData>(n, n, outputBytes / 2,
+                                             lveDevice, displacementFormat,
+                                             layers);
+         group.Derivatives[slot] = std::make_unique<MyTextureData>(
+             dn, dn, outputBytes / 2, lveDevice, derivativesFormat, layers);
+      }
+      group.Turbulence = std::make_unique<MyTextureData>(
+          tn, tn, 2, lveDevice, VK_FORMAT_R32_SFLOAT, layers);
+      group.Phase = std::make_unique<MyTextureData>(
+          n, n, 8, lveDevice, VK_FORMAT_R32G32B32A32_SFLOAT, layers);
+      group.HeldDisplacement_Turbulence = std::make_unique<MyTextureData>(
+          n, n, outputBytes / 2, lveDevice, displacementFormat,
+          2 * layers);
+      group.HeldDerivatives = std::make_unique<MyTextureData>(
+          dn, dn, outputBytes / 2, lveDevice, derivativesFormat,
+          2 * layers);
+   }
+
+   // Storage and sampled descriptors of a texture, the sampler is
+   // ignored for storage images.
+   auto imageInfo = [](MyTextureData &texture) {
+      return VkDescriptorImageInfo{
+          .sampler = texture.Sampler,
+          .imageView = texture.ImageView,
+          .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+      };
+   };
+   // One copy of the cascades in a comp_ubo buffer, without the padding
+   // that aligns the next, as the shaders take its length.
+   auto compInfo = [](LveBuffer &buffer, size_t index) {
+      return buffer.descriptorInfo(buffer.getInstanceSize(),
+                                   index * buffer.getAlignmentSize());
+   };
+
+   // Every cascade in cascade order for the water shaders, the compute
+   // passes read their group's copy. Compact output scales change
+   // between steps, so there is a copy per slot holding the scales its
+   // outputs were packed with. The step writes its own, the water
+   // shaders may read the old one until it runs.
+   const VkDeviceSize storageAlignment =
+       lveDevice.properties.limits.minStorageBufferOffsetAlignment;
    std::unique_ptr<LveBuffer> compBuffer = std::make_unique<LveBuffer>(
-       lveDevice, sizeof(comp_ubo), 4, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-   auto bufferInfo = compBuffer->descriptorInfo();
-
-   LveDescriptorWriter(*gen_butterfly_desc_layout, *computePool)
-       .writeImage(0, &butterflyImageInfo)
-       .writeBuffer(1, &bufferInfo)
-       .build(buterflyDescriptorSet);
-
-   comp_ubo comp_buf[4];
-   comp_buf[0].Size = N;
-   comp_buf[0].LengthScale = 1279.0;
-   comp_buf[0].GravityAcceleration = 9.81;
-   comp_buf[0].Depth = 500.0;
-   comp_buf[1].Size = N;
-   comp_buf[1].LengthScale = 255.0;
-   comp_buf[1].GravityAcceleration = 9.81;
-   comp_buf[1].Depth = 500.0;
-   comp_buf[2].Size = N;
-   comp_buf[2].LengthScale = 17.0;
-   comp_buf[2].GravityAcceleration = 9.81;
-   comp_buf[2].Depth = 500.0;
-   comp_buf[3].Size = N;
-   comp_buf[3].LengthScale = 5.0;
-   comp_buf[3].GravityAcceleration = 9.81;
-   comp_buf[3].Depth = 500.0;
-
-   float boundary1 = glm::pi<float>() / comp_buf[1].LengthScale * 6.f;
-   float boundary2 = glm::pi<float>() / comp_buf[2].LengthScale * 6.f;
-   float boundary3 = glm::pi<float>() / comp_buf[3].LengthScale * 6.f;
-
-   comp_buf[0].CutoffLow = 0.0001f;
-   comp_buf[0].CutoffHigh = boundary1;
-   comp_buf[1].CutoffLow = boundary1;
-   comp_buf[1].CutoffHigh = boundary2;
-   comp_buf[2].CutoffLow = boundary2;
-   comp_buf[2].CutoffHigh = boundary3;
-   comp_buf[3].CutoffLow = boundary3;
-   comp_buf[3].CutoffHigh = 9999.0;
-   compBuffer->map();
-   compBuffer->writeToBuffer(comp_buf);
-   compBuffer->unmap();
-
-   gen_butterfly.instant_dispatch(std::log2(N), N / 2, 1,
-                                  buterflyDescriptorSet);
+       lveDevice, sizeof(comp_ubo) * cascades, simHistory,
+       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, storageAlignment, true);
+
+   // The rows and columns of a cascade further than radius from the
+   // center are all zero. The range is the same on both axes, in
+   // unshifted texel coordinates.
+   typedef struct {
+      glm::uint First;
+      glm::uint Last;
+   } spectrum_band;
+
+   for (cascade_group &group : groups) {
+      uint32_t n = group.size;
+      std::vector<comp_ubo> group_comp;
+      std::vector<spectrum_band> bands;
+      for (uint32_t i : group.cascades) {
+         uint32_t r = radius[i] < n / 2 ? uint32_t(radius[i]) : n / 2;
+         group_comp.push_back(comp_buf[i]);
+         bands.push_back({n / 2 - r, std::min<uint32_t>(n / 2 + r, n - 1)});
+         std::cout << "cascade " << i << ": " << n << "x" << n
+                   << ", spectrum rows " << bands.back().First << ".."
+                   << bands.back().Last << '\n';
+      }
+      group.compBuffer = std::make_unique<LveBuffer>(
+          lveDevice, sizeof(comp_ubo) * group.cascades.size(),
+          simHistory + 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, storageAlignment);
+      // A copy per slot, written as it is submitted, and one for the
+      // spectrum passes.
+      group.compBuffer->map();
+      for (uint32_t index = 0; index <= simHistory; ++index) {
+         group.compBuffer->writeToIndex(group_comp.data(), index);
+      }
+      group.compBuffer->flush();
+      group.heldScaleBuffer = std::make_unique<LveBuffer>(
+          lveDevice, 4 * sizeof(glm::vec4), 2 * group.cascades.size(),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      group.bandBuffer = std::make_unique<LveBuffer>(
+          lveDevice, sizeof(spectrum_band), group.cascades.size(),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+      group.bandBuffer->map();
+      group.bandBuffer->writeToBuffer(bands.data());
+      group.bandBuffer->unmap();
+
+      // Computed in double so every twiddle is the nearest fp32 value.
+      std::vector<glm::vec2> twiddles(n / 2);
+      for (uint32_t k = 0; k < n / 2; ++k) {
+         double angle = -2 * glm::pi<double>() * k / n;
+         twiddles[k] = glm::vec2(std::cos(angle), std::sin(angle));
+      }
+      group.twiddleBuffer = std::make_unique<LveBuffer>(
+          lveDevice, sizeof(glm::vec2), n / 2,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+      group.twiddleBuffer->map();
+      group.twiddleBuffer->writeToBuffer(twiddles.data());
+      group.twiddleBuffer->unmap();
+   }
 
    std::unique_ptr<LveDescriptorSetLayout> init_spec_desc_lay =
        LveDescriptorSetLayout::Builder(lveDevice)
@@ -253,31 +686,6 @@ void SecondApp::run() {
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .build();
 
-   VkDescriptorImageInfo H0KImageInfo = {
-       .imageView = H0K.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   VkDescriptorImageInfo WavesDataImageInfo0 = {
-       .imageView = WavesData0.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   VkDescriptorImageInfo WavesDataImageInfo1 = {
-       .imageView = WavesData1.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   VkDescriptorImageInfo WavesDataImageInfo2 = {
-       .imageView = WavesData2.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   VkDescriptorImageInfo WavesDataImageInfo3 = {
-       .imageView = WavesData3.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
    typedef struct {
       glm::float32 scale;
       glm::float32 angle;
@@ -295,101 +703,78 @@ void SecondApp::run() {
                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
    auto specBufferInfo = specBuf->descriptorInfo();
 
-   auto bufferInfo0 =
-       compBuffer->descriptorInfo(sizeof(comp_ubo), 0 * sizeof(comp_ubo));
-   VkDescriptorSet init_spec_desc_set0 = {};
-   LveDescriptorWriter(*init_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &WavesDataImageInfo0)
-       .writeBuffer(2, &specBufferInfo)
-       .writeBuffer(3, &bufferInfo0)
-       .build(init_spec_desc_set0);
-
-   auto bufferInfo1 =
-       compBuffer->descriptorInfo(sizeof(comp_ubo), 1 * sizeof(comp_ubo));
-   VkDescriptorSet init_spec_desc_set1 = {};
-   LveDescriptorWriter(*init_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &WavesDataImageInfo1)
-       .writeBuffer(2, &specBufferInfo)
-       .writeBuffer(3, &bufferInfo1)
-       .build(init_spec_desc_set1);
-
-   auto bufferInfo2 =
-       compBuffer->descriptorInfo(sizeof(comp_ubo), 2 * sizeof(comp_ubo));
-   VkDescriptorSet init_spec_desc_set2 = {};
-   LveDescriptorWriter(*init_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &WavesDataImageInfo2)
-       .writeBuffer(2, &specBufferInfo)
-       .writeBuffer(3, &bufferInfo2)
-       .build(init_spec_desc_set2);
-
-   auto bufferInfo3 =
-       compBuffer->descriptorInfo(sizeof(comp_ubo), 3 * sizeof(comp_ubo));
-   VkDescriptorSet init_spec_desc_set3 = {};
-   LveDescriptorWriter(*init_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &WavesDataImageInfo3)
-       .writeBuffer(2, &specBufferInfo)
-       .writeBuffer(3, &bufferInfo3)
-       .build(init_spec_desc_set3);
-
-   SpectrumConfig spec_conf[2];
-   spec_conf[0].scale = 1;
-   spec_conf[0].windSpeed = 0.5;
-   spec_conf[0].windDirection = -0.5;
-   spec_conf[0].fetch = 100000;
-   spec_conf[0].spreadBlend = 1;
-   spec_conf[0].swell = 0.198;
-   spec_conf[0].peakEnhancement = 3.3;
-   spec_conf[0].shortWavesFade = 0.01;
-
-   spec_conf[1].scale = 0;
-   spec_conf[1].windSpeed = 1;
-   spec_conf[1].windDirection = 0;
-   spec_conf[1].fetch = 300000;
-   spec_conf[1].spreadBlend = 1;
-   spec_conf[1].swell = 1;
-   spec_conf[1].peakEnhancement = 3.3;
-   spec_conf[1].shortWavesFade = 0.01;
-   SpectrumConfig new_conf[2];
-   new_conf[0] = spec_conf[0];
-   new_conf[1] = spec_conf[1];
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo H0KImageInfo = imageInfo(*group.H0K);
+      auto groupBufferInfo = compInfo(*group.compBuffer, simHistory);
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         VkDescriptorImageInfo WavesDataImageInfo =
+             imageInfo(*group.WavesData[set]);
+         LveDescriptorWriter(*init_spec_desc_lay, *computePool)
+             .writeImage(0, &H0KImageInfo)
+             .writeImage(1, &WavesDataImageInfo)
+             .writeBuffer(2, &specBufferInfo)
+             .writeBuffer(3, &groupBufferInfo)
+             .build(group.init_spec_desc_set[set]);
+      }
+   }
 
+   // The spectrum as edited in the GUI, which bumps version on every
+   // change.
+   VersionedSpectrumConfig spec_conf;
+   spec_conf.config[0].scale = 1;
+   spec_conf.config[0].windSpeed = 0.5;
+   spec_conf.config[0].windDirection = -0.5;
+   spec_conf.config[0].fetch = 100000;
+   spec_conf.config[0].spreadBlend = 1;
+   spec_conf.config[0].swell = 0.198;
+   spec_conf.config[0].peakEnhancement = 3.3;
+   spec_conf.config[0].shortWavesFade = 0.01;
+
+   spec_conf.config[1].scale = 0;
+   spec_conf.config[1].windSpeed = 1;
+   spec_conf.config[1].windDirection = 0;
+   spec_conf.config[1].fetch = 300000;
+   spec_conf.config[1].spreadBlend = 1;
+   spec_conf.config[1].swell = 1;
+   spec_conf.config[1].peakEnhancement = 3.3;
+   spec_conf.config[1].shortWavesFade = 0.01;
+   spec_conf.version = 0;
+
+   // Written to specBuf only while no rebuild is reading it.
    SpectrumParameters spec_params[2];
-   spec_params[0].scale = spec_conf[0].scale;
-   spec_params[0].angle = spec_conf[0].windDirection;
-   spec_params[0].spreadBlend = spec_conf[0].spreadBlend;
-   spec_params[0].swell = spec_conf[0].swell;
-   spec_params[0].alpha =
-       jonswap_alpha(comp_buf[0].GravityAcceleration, spec_conf[0].fetch,
-                     spec_conf[0].windSpeed);
-   spec_params[0].peakOmega =
-       jonswap_peak_features(comp_buf[0].GravityAcceleration,
-                             spec_conf[0].fetch, spec_conf[0].windSpeed);
-   spec_params[0].gamma = spec_conf[0].peakEnhancement;
-   spec_params[0].shortWavesFade = spec_conf[0].shortWavesFade;
-
-   spec_params[1].scale = spec_conf[1].scale;
-   spec_params[1].angle = spec_conf[1].windDirection;
-   spec_params[1].spreadBlend = spec_conf[1].spreadBlend;
-   spec_params[1].swell = spec_conf[1].swell;
-   spec_params[1].alpha =
-       jonswap_alpha(comp_buf[0].GravityAcceleration, spec_conf[1].fetch,
-                     spec_conf[1].windSpeed);
-   spec_params[1].peakOmega =
-       jonswap_peak_features(comp_buf[0].GravityAcceleration,
-                             spec_conf[1].fetch, spec_conf[1].windSpeed);
-   spec_params[1].gamma = spec_conf[1].peakEnhancement;
-   spec_params[1].shortWavesFade = spec_conf[1].shortWavesFade;
+   auto updateSpectrumParameters = [&]() {
+      for (size_t s = 0; s < 2; ++s) {
+         const SpectrumConfig &conf = spec_conf.config[s];
+         spec_params[s].scale = conf.scale;
+         spec_params[s].angle = conf.windDirection;
+         spec_params[s].spreadBlend = conf.spreadBlend;
+         spec_params[s].swell = conf.swell;
+         spec_params[s].alpha = jonswap_alpha(
+             comp_buf[0].GravityAcceleration, conf.fetch, conf.windSpeed);
+         spec_params[s].peakOmega = jonswap_peak_features(
+             comp_buf[0].GravityAcceleration, conf.fetch, conf.windSpeed);
+         spec_params[s].gamma = conf.peakEnhancement;
+         spec_params[s].shortWavesFade = conf.shortWavesFade;
+      }
+   };
+   // Identifies the initial spectrum spec_params and the cascades'
+   // settings build, 0 is left for an empty set.
+   auto spectrumKey = [&]() {
+      uint64_t key = fnv1a(spec_params, sizeof(spec_params));
+      for (uint32_t i = 0; i < cascades; ++i) {
+         // Everything init_spectrum reads, up to Group.
+         key = fnv1a(&comp_buf[i], offsetof(comp_ubo, Group), key);
+      }
+      return key ? key : 1;
+   };
+   updateSpectrumParameters();
    specBuf->map();
    specBuf->writeToBuffer(spec_params);
    specBuf->flush();
 
    ComputeSystem init_spec{lveDevice,
                            {init_spec_desc_lay->getDescriptorSetLayout()},
-                           "obj/shaders/init_spectrum.comp.spv"};
+                           simulationShader("init_spectrum")};
 
    std::unique_ptr<LveDescriptorSetLayout> conj_spec_desc_lay =
        LveDescriptorSetLayout::Builder(lveDevice)
@@ -401,115 +786,239 @@ void SecondApp::run() {
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .build();
 
-   VkDescriptorImageInfo H0ImageInfo0 = {
-       .imageView = H00.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo H0KImageInfo = imageInfo(*group.H0K);
+      auto groupBufferInfo = compInfo(*group.compBuffer, simHistory);
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         VkDescriptorImageInfo H0ImageInfo = imageInfo(*group.H0[set]);
+         LveDescriptorWriter(*conj_spec_desc_lay, *computePool)
+             .writeImage(0, &H0KImageInfo)
+             .writeImage(1, &H0ImageInfo)
+             .writeBuffer(2, &groupBufferInfo)
+             .build(group.conj_spec_desc_set[set]);
+      }
+   }
 
-   VkDescriptorImageInfo H0ImageInfo1 = {
-       .imageView = H01.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   ComputeSystem conj_spec{lveDevice,
+                           {conj_spec_desc_lay->getDescriptorSetLayout()},
+                           simulationShader("conj_spectrum")};
 
-   VkDescriptorImageInfo H0ImageInfo2 = {
-       .imageView = H02.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   // RMS bounds of each cascade's outputs, two per cascade laid out by
+   // group, see output_range.comp. Only run for compact outputs.
+   std::unique_ptr<LveBuffer> rangeBuffer = std::make_unique<LveBuffer>(
+       lveDevice, sizeof(glm::vec4), 2 * cascades,
+       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   rangeBuffer->map();
+   auto rangeBufferInfo = rangeBuffer->descriptorInfo();
 
-   VkDescriptorImageInfo H0ImageInfo3 = {
-       .imageView = H03.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   std::unique_ptr<LveDescriptorSetLayout> range_desc_lay =
+       LveDescriptorSetLayout::Builder(lveDevice)
+           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .build();
 
-   VkDescriptorSet conj_spec_desc_set0 = {};
-   LveDescriptorWriter(*conj_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &H0ImageInfo0)
-       .writeBuffer(2, &bufferInfo)
-       .build(conj_spec_desc_set0);
-
-   VkDescriptorSet conj_spec_desc_set1 = {};
-   LveDescriptorWriter(*conj_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &H0ImageInfo1)
-       .writeBuffer(2, &bufferInfo)
-       .build(conj_spec_desc_set1);
-
-   VkDescriptorSet conj_spec_desc_set2 = {};
-   LveDescriptorWriter(*conj_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &H0ImageInfo2)
-       .writeBuffer(2, &bufferInfo)
-       .build(conj_spec_desc_set2);
-
-   VkDescriptorSet conj_spec_desc_set3 = {};
-   LveDescriptorWriter(*conj_spec_desc_lay, *computePool)
-       .writeImage(0, &H0KImageInfo)
-       .writeImage(1, &H0ImageInfo3)
-       .writeBuffer(2, &bufferInfo)
-       .build(conj_spec_desc_set3);
+   for (cascade_group &group : groups) {
+      auto bandBufferInfo = group.bandBuffer->descriptorInfo();
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         VkDescriptorImageInfo H0ImageInfo = imageInfo(*group.H0[set]);
+         VkDescriptorImageInfo WavesDataImageInfo =
+             imageInfo(*group.WavesData[set]);
+         LveDescriptorWriter(*range_desc_lay, *computePool)
+             .writeImage(0, &H0ImageInfo)
+             .writeImage(1, &WavesDataImageInfo)
+             .writeBuffer(2, &bandBufferInfo)
+             .writeBuffer(3, &rangeBufferInfo)
+             .build(group.range_desc_set[set]);
+      }
+   }
 
-   ComputeSystem conj_spec{lveDevice,
-                           {conj_spec_desc_lay->getDescriptorSetLayout()},
-                           "obj/shaders/conj_spectrum.comp.spv"};
-
-   init_spec.instant_dispatch(N, N, 1, init_spec_desc_set0);
-   conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set0);
-   init_spec.instant_dispatch(N, N, 1, init_spec_desc_set1);
-   conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set1);
-   init_spec.instant_dispatch(N, N, 1, init_spec_desc_set2);
-   conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set2);
-   init_spec.instant_dispatch(N, N, 1, init_spec_desc_set3);
-   conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set3);
-
-   VkDescriptorImageInfo DxDzDyDxz0ImageInfo = {
-       .imageView = DxDzDyDxz0.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo DyxDyzDxxDzz0ImageInfo = {
-       .imageView = DyxDyzDxxDzz0.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+   typedef struct {
+      glm::float32 lambda;
+      glm::uint first;
+   } range_buff;
+
+   ComputeSystem output_range{lveDevice,
+                              {range_desc_lay->getDescriptorSetLayout()},
+                              simulationShader("output_range"),
+                              {},
+                              sizeof(range_buff)};
+
+   // Writes comp_buf to the copy of slot in each group buffer.
+   std::vector<comp_ubo> packedComp(cascades);
+   auto writeCascadeBuffers = [&](size_t slot) {
+      for (uint32_t i = 0; i < cascades; ++i) {
+         packedComp[packed(i)] = comp_buf[i];
+      }
+      for (cascade_group &group : groups) {
+         group.compBuffer->writeToIndex(&packedComp[group.first], slot);
+         group.compBuffer->flushIndex(slot);
+      }
    };
 
-   VkDescriptorImageInfo DxDzDyDxz1ImageInfo = {
-       .imageView = DxDzDyDxz1.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo DyxDyzDxxDzz1ImageInfo = {
-       .imageView = DyxDyzDxxDzz1.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+   // The compact formats cover 4 times the RMS bound either side of
+   // zero, the derivatives are centered already. The bounds are for a
+   // lambda of 1, the choppiness every step runs with. Fits comp_buf to
+   // the last init's range pass, writeCascadeBuffers uploads it.
+   auto fitOutputRanges = [&]() {
+      rangeBuffer->invalidate();
+      const glm::vec4 *rms =
+          static_cast<const glm::vec4 *>(rangeBuffer->getMappedMemory());
+      for (size_t i = 0; i < cascades; ++i) {
+         glm::vec4 d = glm::max(rms[2 * packed(i)], glm::vec4(1e-6f));
+         glm::vec4 v = glm::max(rms[2 * packed(i) + 1], glm::vec4(1e-6f));
+         comp_buf[i].DisplacementScale = glm::vec4(glm::vec3(8.f * d), 1.f);
+         comp_buf[i].DisplacementBias = glm::vec4(glm::vec3(-4.f * d), 0.f);
+         comp_buf[i].DerivativesScale = 4.f * v;
+         comp_buf[i].DerivativesBias = glm::vec4(0.f);
+      }
    };
 
-   VkDescriptorImageInfo DxDzDyDxz2ImageInfo = {
-       .imageView = DxDzDyDxz2.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo DyxDyzDxxDzz2ImageInfo = {
-       .imageView = DyxDyzDxxDzz2.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   // Spectrum set the steps read.
+   size_t frontSpectrum = 0;
 
-   VkDescriptorImageInfo DxDzDyDxz3ImageInfo = {
-       .imageView = DxDzDyDxz3.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo DyxDyzDxxDzz3ImageInfo = {
-       .imageView = DyxDyzDxxDzz3.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+   // Every pass of a spectrum init for every cascade, writing set. The
+   // first barrier orders it after any simulation step still reading
+   // set on the compute queue.
+   auto recordSpectrumInit = [&](VkCommandBuffer cmd, size_t set) {
+      ComputeSystem::forget_bindings();
+      LvePipeline::barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_ACCESS_SHADER_READ_BIT |
+                               VK_ACCESS_SHADER_WRITE_BIT,
+                           VK_ACCESS_SHADER_WRITE_BIT);
+      for (cascade_group &group : groups) {
+         init_spec.dispatch(group.size, group.size, group.cascades.size(),
+                            group.init_spec_desc_set[set], cmd);
+      }
+      LvePipeline::barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+      for (cascade_group &group : groups) {
+         conj_spec.dispatch(group.size, group.size, group.cascades.size(),
+                            group.conj_spec_desc_set[set], cmd);
+      }
+      if (compact) {
+         LvePipeline::barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+         for (cascade_group &group : groups) {
+            range_buff push{1.f, group.first};
+            output_range.dispatch(256, 1, group.cascades.size(),
+                                  group.range_desc_set[set], cmd, &push);
+         }
+         LvePipeline::barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_HOST_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_ACCESS_HOST_READ_BIT);
+      }
    };
+   // The first spectrum is built before anything runs.
+   {
+      VkCommandBuffer cmd = lveDevice.beginSingleTimeComputeCommands();
+      recordSpectrumInit(cmd, frontSpectrum);
+      lveDevice.endCommandBuffer(cmd);
+      conj_spec.await(cmd);
+      if (compact) {
+         fitOutputRanges();
+         for (size_t index = 0; index <= simHistory; ++index) {
+            writeCascadeBuffers(index);
+         }
+      }
+      // The water shaders read the slots before their first step.
+      VkCommandBuffer fill = lveDevice.beginSingleTimeComputeCommands();
+      for (size_t slot = 0; slot < simHistory; ++slot) {
+         compBuffer->update(fill, sizeof(comp_ubo) * cascades,
+                            comp_buf.data(),
+                            slot * compBuffer->getAlignmentSize());
+      }
+      lveDevice.endCommandBuffer(fill);
+      conj_spec.await(fill);
+   }
 
+   // Push constants of the timed spectrum and merge passes. cascades
+   // has a bit set for each layer updated this step, their cascade_step
+   // entries start at schedule. spectrum_blend is the weight of the front
+   // spectrum set against H0Blend.
    typedef struct {
       glm::float32 time;
       glm::float32 delta_time;
       glm::float32 lambda;
+      glm::uint cascades;
+      glm::uint schedule;
+      glm::float32 tick;
+      glm::uint flags;
+      glm::float32 spectrum_blend;
    } lambda_buff;
 
-   std::unique_ptr<LveBuffer> lambdaBuffer =
-       std::make_unique<LveBuffer>(lveDevice, sizeof(lambda_buff), 1,
-                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-   auto lambdaBufferInfo = lambdaBuffer->descriptorInfo();
-   lambdaBuffer->map();
+   // Per cascade part of a step, mirrored in the compute shaders that
+   // read the schedule buffer.
+   typedef struct {
+      // Phasor ticks and time since the cascade was last updated.
+      glm::uint ticks;
+      glm::uint flags;
+      glm::float32 delta_time;
+      // Position between the two latest updates, and the held layer of
+      // the latest one, for the cascades not updated every step.
+      glm::float32 blend;
+      glm::uint newest;
+   } cascade_step;
+
+   // Push constants of cascade_interpolate.comp. cascades has a bit set
+   // for each layer not updated every step.
+   typedef struct {
+      glm::uint cascades;
+      glm::uint schedule;
+   } interpolation_buff;
+
+   // Push constants of cascade_dispatch.comp.
+   typedef struct {
+      glm::uvec2 texel_groups;
+      glm::uvec2 row_groups;
+      glm::uvec2 h_radix_groups;
+      glm::uvec2 v_radix_groups;
+      glm::uint cascades;
+      glm::uint interpolated;
+      glm::uint first;
+   } dispatch_buff;
+
+   // Push constants of the FFT passes.
+   typedef struct {
+      glm::int32 stage;
+      glm::uint cascades;
+   } butterfly_buff;
+   typedef struct {
+      glm::uint shifted;
+      glm::uint cascades;
+   } fft_buff;
+
+   // lambda_buff.flags and cascade_step.flags, mirrored in
+   // timed_spectrum.comp and cascade_interpolate.comp.
+   enum : glm::uint {
+      PhasorEvolution = 1,
+      PhasorReset = 2,
+      PhasorRenormalize = 4,
+      CascadeUpdated = 8,
+      CascadeRestart = 16,
+   };
+   // The phasors advance in whole ticks, at most phasorMaxTicks a step,
+   // and are renormalized every phasorRenormalizeTicks.
+   constexpr float phasorTick = 1.f / 60.f;
+   constexpr uint32_t phasorMaxTicks = 8;
+   constexpr uint32_t phasorRenormalizeTicks = 256;
+
+   // One row of cascade_step per output slot, written right before the
+   // slot is submitted. Rows are laid out by group.
+   std::unique_ptr<LveBuffer> scheduleBuffer = std::make_unique<LveBuffer>(
+       lveDevice, sizeof(cascade_step) * cascades, simHistory,
+       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   scheduleBuffer->map();
+   auto scheduleBufferInfo = scheduleBuffer->descriptorInfo();
 
    std::unique_ptr<LveDescriptorSetLayout> butterfly_desc_lay =
        LveDescriptorSetLayout::Builder(lveDevice)
@@ -517,180 +1026,134 @@ void SecondApp::run() {
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                        VK_SHADER_STAGE_COMPUTE_BIT)
-           .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+           .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .build();
 
-   VkDescriptorImageInfo ping_pong1_0_ImageInfo = {
-       .imageView = ping_pong1_0.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo ping_pong2_0_ImageInfo = {
-       .imageView = ping_pong2_0.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   VkDescriptorImageInfo ping_pong1_1_ImageInfo = {
-       .imageView = ping_pong1_1.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo ping_pong2_1_ImageInfo = {
-       .imageView = ping_pong2_1.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   VkDescriptorImageInfo ping_pong1_2_ImageInfo = {
-       .imageView = ping_pong1_2.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo ping_pong2_2_ImageInfo = {
-       .imageView = ping_pong2_2.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   VkDescriptorImageInfo ping_pong1_3_ImageInfo = {
-       .imageView = ping_pong1_3.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo ping_pong2_3_ImageInfo = {
-       .imageView = ping_pong2_3.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-
-   std::unique_ptr<LveBuffer> stageBuffer =
-       std::make_unique<LveBuffer>(lveDevice, sizeof(glm::int32), 1,
-                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-   auto stageBufferInfo = stageBuffer->descriptorInfo();
-
-   VkDescriptorSet butterfly_desc_set_1_1_0 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz0ImageInfo)
-       .writeImage(1, &ping_pong1_0_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_1_0);
-   VkDescriptorSet butterfly_desc_set_2_1_0 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong1_0_ImageInfo)
-       .writeImage(1, &DxDzDyDxz0ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_1_0);
-   VkDescriptorSet butterfly_desc_set_1_2_0 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz0ImageInfo)
-       .writeImage(1, &ping_pong2_0_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_2_0);
-   VkDescriptorSet butterfly_desc_set_2_2_0 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong2_0_ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz0ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_2_0);
-
-   VkDescriptorSet butterfly_desc_set_1_1_1 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz1ImageInfo)
-       .writeImage(1, &ping_pong1_1_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_1_1);
-   VkDescriptorSet butterfly_desc_set_2_1_1 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong1_1_ImageInfo)
-       .writeImage(1, &DxDzDyDxz1ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_1_1);
-   VkDescriptorSet butterfly_desc_set_1_2_1 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz1ImageInfo)
-       .writeImage(1, &ping_pong2_1_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_2_1);
-   VkDescriptorSet butterfly_desc_set_2_2_1 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong2_1_ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz1ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_2_1);
-
-   VkDescriptorSet butterfly_desc_set_1_1_2 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz2ImageInfo)
-       .writeImage(1, &ping_pong1_2_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_1_2);
-   VkDescriptorSet butterfly_desc_set_2_1_2 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong1_2_ImageInfo)
-       .writeImage(1, &DxDzDyDxz2ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_1_2);
-   VkDescriptorSet butterfly_desc_set_1_2_2 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz2ImageInfo)
-       .writeImage(1, &ping_pong2_2_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_2_2);
-   VkDescriptorSet butterfly_desc_set_2_2_2 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong2_2_ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz2ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_2_2);
-
-   VkDescriptorSet butterfly_desc_set_1_1_3 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz3ImageInfo)
-       .writeImage(1, &ping_pong1_3_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_1_3);
-   VkDescriptorSet butterfly_desc_set_2_1_3 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong1_3_ImageInfo)
-       .writeImage(1, &DxDzDyDxz3ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_1_3);
-   VkDescriptorSet butterfly_desc_set_1_2_3 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz3ImageInfo)
-       .writeImage(1, &ping_pong2_3_ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_1_2_3);
-   VkDescriptorSet butterfly_desc_set_2_2_3 = {};
-   LveDescriptorWriter(*butterfly_desc_lay, *computePool)
-       .writeImage(0, &ping_pong2_3_ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz3ImageInfo)
-       .writeImage(2, &butterflyImageInfo)
-       .writeBuffer(3, &stageBufferInfo)
-       .build(butterfly_desc_set_2_2_3);
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo spectrum[2] = {imageInfo(*group.DxDzDyDxz),
+                                           imageInfo(*group.DyxDyzDxxDzz)};
+      VkDescriptorImageInfo ping_pong[2] = {imageInfo(*group.ping_pong1),
+                                            imageInfo(*group.ping_pong2)};
+      auto twiddleBufferInfo = group.twiddleBuffer->descriptorInfo();
+      auto bandBufferInfo = group.bandBuffer->descriptorInfo();
+      for (size_t field = 0; field < 2; ++field) {
+         LveDescriptorWriter(*butterfly_desc_lay, *computePool)
+             .writeImage(0, &spectrum[field])
+             .writeImage(1, &ping_pong[field])
+             .writeBuffer(2, &twiddleBufferInfo)
+             .writeBuffer(3, &bandBufferInfo)
+             .build(group.butterfly_desc_sets[0][field]);
+         LveDescriptorWriter(*butterfly_desc_lay, *computePool)
+             .writeImage(0, &ping_pong[field])
+             .writeImage(1, &spectrum[field])
+             .writeBuffer(2, &twiddleBufferInfo)
+             .writeBuffer(3, &bandBufferInfo)
+             .build(group.butterfly_desc_sets[1][field]);
+      }
+   }
 
+   // The stage index of the multi-pass FFT is a push constant.
    ComputeSystem h_butterfly{
        lveDevice,
        {butterfly_desc_lay->getDescriptorSetLayout()},
-       "obj/shaders/h_butterfly.comp.spv"};
+       simulationShader("h_butterfly"),
+       {},
+       sizeof(butterfly_buff)};
 
    ComputeSystem v_butterfly{
        lveDevice,
        {butterfly_desc_lay->getDescriptorSetLayout()},
-       "obj/shaders/v_butterfly.comp.spv"};
+       simulationShader("v_butterfly"),
+       {},
+       sizeof(butterfly_buff)};
+
+   // Radix passes of the multi-pass FFT. With subgroup shuffles a group
+   // of 4 * lanes texels is split between up to 4 lanes, exchanging
+   // values for the first stages, otherwise an invocation runs a radix-4
+   // group alone.
+   const VkPhysicalDeviceSubgroupProperties &subgroup =
+       lveDevice.subgroupProperties;
+   const VkSubgroupFeatureFlags shuffleOps =
+       VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_SHUFFLE_BIT;
+   bool subgroupShuffle =
+       subgroup.subgroupSize >= 2 &&
+       (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+       (subgroup.supportedOperations & shuffleOps) == shuffleOps;
+   uint32_t radixLaneLog = 0;
+   if (subgroupShuffle) {
+      radixLaneLog = subgroup.subgroupSize >= 4 ? 2 : 1;
+   }
+
+   // A whole row has to fit in the shared memory of one workgroup for
+   // the single dispatch FFT, split over up to maxButterflies butterflies
+   // per invocation. Otherwise it runs as radix passes.
+   // The pipelines are specialized for the group's size.
+   const VkPhysicalDeviceLimits &limits = lveDevice.properties.limits;
+   constexpr uint32_t maxButterflies = 8;
+   uint32_t maxWidth = std::min(limits.maxComputeWorkGroupInvocations,
+                                limits.maxComputeWorkGroupSize[0]);
+   for (cascade_group &group : groups) {
+      uint32_t n = group.size;
+      uint32_t log_n = group.logSize;
+      group.butterflies = 1;
+      while (n / 2 / group.butterflies > maxWidth) group.butterflies *= 2;
+      group.sharedFFT =
+          group.butterflies <= maxButterflies &&
+          n * sizeof(glm::vec4) <= limits.maxComputeSharedMemorySize;
+      // Sizes start at 16, there are always enough stages for one pass.
+      group.radixLog = 2 + radixLaneLog;
+      group.radixLanes = 1u << radixLaneLog;
+      if (group.sharedFFT) {
+         std::cout << "FFT " << n
+                   << ": shared memory, one dispatch per direction, "
+                   << group.butterflies << " butterflies per invocation\n";
+      } else {
+         std::cout << "FFT " << n << ": radix-" << (1u << group.radixLog)
+                   << " passes"
+                   << (group.radixLanes > 1 ? " over subgroup lanes" : "")
+                   << ", " << log_n / group.radixLog + log_n % group.radixLog
+                   << " dispatches per direction\n";
+         std::string radixShader = simulationShader("butterfly_radix");
+         std::vector<uint32_t> h_spec = {n, log_n, 0, group.radixLog};
+         if (group.radixLanes > 1) {
+            radixShader = simulationShader("butterfly_radix_subgroup");
+            h_spec.push_back(radixLaneLog);
+         }
+         std::vector<uint32_t> v_spec = h_spec;
+         v_spec[2] = 1;
+         group.h_radix = std::make_unique<ComputeSystem>(
+             lveDevice,
+             std::vector<VkDescriptorSetLayout>{
+                 butterfly_desc_lay->getDescriptorSetLayout()},
+             radixShader, h_spec, sizeof(butterfly_buff));
+         group.v_radix = std::make_unique<ComputeSystem>(
+             lveDevice,
+             std::vector<VkDescriptorSetLayout>{
+                 butterfly_desc_lay->getDescriptorSetLayout()},
+             radixShader, v_spec, sizeof(butterfly_buff));
+      }
+      if (group.sharedFFT) {
+         group.h_fft = std::make_unique<ComputeSystem>(
+             lveDevice,
+             std::vector<VkDescriptorSetLayout>{
+                 butterfly_desc_lay->getDescriptorSetLayout()},
+             simulationShader("stockham_fft"),
+             std::vector<uint32_t>{n, log_n, 0, n / 2 / group.butterflies,
+                                   group.butterflies},
+             sizeof(fft_buff));
+         group.v_fft = std::make_unique<ComputeSystem>(
+             lveDevice,
+             std::vector<VkDescriptorSetLayout>{
+                 butterfly_desc_lay->getDescriptorSetLayout()},
+             simulationShader("stockham_fft"),
+             std::vector<uint32_t>{n, log_n, 1, n / 2 / group.butterflies,
+                                   group.butterflies},
+             sizeof(fft_buff));
+      }
+   }
 
    std::unique_ptr<LveDescriptorSetLayout> perm_inv_desc_lay =
        LveDescriptorSetLayout::Builder(lveDevice)
@@ -698,45 +1161,21 @@ void SecondApp::run() {
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .build();
 
-   VkDescriptorSet perm_inv_desc_set_1_0 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz0ImageInfo)
-       .build(perm_inv_desc_set_1_0);
-   VkDescriptorSet perm_inv_desc_set_2_0 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz0ImageInfo)
-       .build(perm_inv_desc_set_2_0);
-
-   VkDescriptorSet perm_inv_desc_set_1_1 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz1ImageInfo)
-       .build(perm_inv_desc_set_1_1);
-   VkDescriptorSet perm_inv_desc_set_2_1 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz1ImageInfo)
-       .build(perm_inv_desc_set_2_1);
-
-   VkDescriptorSet perm_inv_desc_set_1_2 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz2ImageInfo)
-       .build(perm_inv_desc_set_1_2);
-   VkDescriptorSet perm_inv_desc_set_2_2 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz2ImageInfo)
-       .build(perm_inv_desc_set_2_2);
-
-   VkDescriptorSet perm_inv_desc_set_1_3 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz3ImageInfo)
-       .build(perm_inv_desc_set_1_3);
-   VkDescriptorSet perm_inv_desc_set_2_3 = {};
-   LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
-       .writeImage(0, &DyxDyzDxxDzz3ImageInfo)
-       .build(perm_inv_desc_set_2_3);
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo spectrum[2] = {imageInfo(*group.DxDzDyDxz),
+                                           imageInfo(*group.DyxDyzDxxDzz)};
+      for (size_t field = 0; field < 2; ++field) {
+         LveDescriptorWriter(*perm_inv_desc_lay, *computePool)
+             .writeImage(0, &spectrum[field])
+             .build(group.perm_inv_desc_sets[field]);
+      }
+   }
 
    ComputeSystem perm_inv{lveDevice,
                           {perm_inv_desc_lay->getDescriptorSetLayout()},
-                          "obj/shaders/inv_perm.comp.spv"};
+                          simulationShader("inv_perm"),
+                          {},
+                          sizeof(glm::uint)};
 
    std::unique_ptr<LveDescriptorSetLayout> timed_spec_desc_lay =
        LveDescriptorSetLayout::Builder(lveDevice)
@@ -748,52 +1187,203 @@ void SecondApp::run() {
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                        VK_SHADER_STAGE_COMPUTE_BIT)
-           .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+           .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .build();
 
-   VkDescriptorSet timed_spec_desc_set0 = {};
-   LveDescriptorWriter(*timed_spec_desc_lay, *computePool)
-       .writeImage(0, &H0ImageInfo0)
-       .writeImage(1, &WavesDataImageInfo0)
-       .writeImage(2, &DxDzDyDxz0ImageInfo)
-       .writeImage(3, &DyxDyzDxxDzz0ImageInfo)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(timed_spec_desc_set0);
-
-   VkDescriptorSet timed_spec_desc_set1 = {};
-   LveDescriptorWriter(*timed_spec_desc_lay, *computePool)
-       .writeImage(0, &H0ImageInfo1)
-       .writeImage(1, &WavesDataImageInfo1)
-       .writeImage(2, &DxDzDyDxz1ImageInfo)
-       .writeImage(3, &DyxDyzDxxDzz1ImageInfo)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(timed_spec_desc_set1);
-
-   VkDescriptorSet timed_spec_desc_set2 = {};
-   LveDescriptorWriter(*timed_spec_desc_lay, *computePool)
-       .writeImage(0, &H0ImageInfo2)
-       .writeImage(1, &WavesDataImageInfo2)
-       .writeImage(2, &DxDzDyDxz2ImageInfo)
-       .writeImage(3, &DyxDyzDxxDzz2ImageInfo)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(timed_spec_desc_set2);
-
-   VkDescriptorSet timed_spec_desc_set3 = {};
-   LveDescriptorWriter(*timed_spec_desc_lay, *computePool)
-       .writeImage(0, &H0ImageInfo3)
-       .writeImage(1, &WavesDataImageInfo3)
-       .writeImage(2, &DxDzDyDxz3ImageInfo)
-       .writeImage(3, &DyxDyzDxxDzz3ImageInfo)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(timed_spec_desc_set3);
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo H0BlendImageInfo = imageInfo(*group.H0Blend);
+      VkDescriptorImageInfo DxDzDyDxzImageInfo =
+          imageInfo(*group.DxDzDyDxz);
+      VkDescriptorImageInfo DyxDyzDxxDzzImageInfo =
+          imageInfo(*group.DyxDyzDxxDzz);
+      VkDescriptorImageInfo PhaseImageInfo = imageInfo(*group.Phase);
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         VkDescriptorImageInfo H0ImageInfo = imageInfo(*group.H0[set]);
+         VkDescriptorImageInfo WavesDataImageInfo =
+             imageInfo(*group.WavesData[set]);
+         LveDescriptorWriter(*timed_spec_desc_lay, *computePool)
+             .writeImage(0, &H0ImageInfo)
+             .writeImage(1, &WavesDataImageInfo)
+             .writeImage(2, &DxDzDyDxzImageInfo)
+             .writeImage(3, &DyxDyzDxxDzzImageInfo)
+             .writeImage(4, &PhaseImageInfo)
+             .writeBuffer(5, &scheduleBufferInfo)
+             .writeImage(6, &H0BlendImageInfo)
+             .build(group.timed_spec_desc_set[set]);
+      }
+   }
 
    ComputeSystem timed_spec{
        lveDevice,
        {timed_spec_desc_lay->getDescriptorSetLayout()},
-       "obj/shaders/timed_spectrum.comp.spv"};
+       simulationShader("timed_spectrum"),
+       {0, features},
+       sizeof(lambda_buff)};
+   ComputeSystem timed_spec_shifted{
+       lveDevice,
+       {timed_spec_desc_lay->getDescriptorSetLayout()},
+       simulationShader("timed_spectrum"),
+       {1, features},
+       sizeof(lambda_buff)};
+
+   std::unique_ptr<LveDescriptorSetLayout> blend_spec_desc_lay =
+       LveDescriptorSetLayout::Builder(lveDevice)
+           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .build();
+
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo H0BlendImageInfo = imageInfo(*group.H0Blend);
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         VkDescriptorImageInfo H0ImageInfo = imageInfo(*group.H0[set]);
+         LveDescriptorWriter(*blend_spec_desc_lay, *computePool)
+             .writeImage(0, &H0BlendImageInfo)
+             .writeImage(1, &H0ImageInfo)
+             .build(group.blend_spec_desc_set[set]);
+      }
+   }
+
+   ComputeSystem blend_spec{lveDevice,
+                            {blend_spec_desc_lay->getDescriptorSetLayout()},
+                            simulationShader("blend_spectrum"),
+                            {},
+                            sizeof(glm::float32)};
 
    std::unique_ptr<LveDescriptorSetLayout> text_merg_desc_lay =
+       LveDescriptorSetLayout::Builder(lveDevice)
+           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .build();
+
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo DxDzDyDxzImageInfo =
+          imageInfo(*group.DxDzDyDxz);
+      VkDescriptorImageInfo DyxDyzDxxDzzImageInfo =
+          imageInfo(*group.DyxDyzDxxDzz);
+      VkDescriptorImageInfo TurbulenceImageInfo =
+          imageInfo(*group.Turbulence);
+      for (size_t slot = 0; slot < simHistory; ++slot) {
+         auto groupBufferInfo = compInfo(*group.compBuffer, slot);
+         VkDescriptorImageInfo Displacement_TurbulenceImageInfo =
+             imageInfo(*group.Displacement_Turbulence[slot]);
+         VkDescriptorImageInfo DerivativesImageInfo =
+             imageInfo(*group.Derivatives[slot]);
+         LveDescriptorWriter(*text_merg_desc_lay, *computePool)
+             .writeImage(0, &DxDzDyDxzImageInfo)
+             .writeImage(1, &DyxDyzDxxDzzImageInfo)
+             .writeImage(2, &Displacement_TurbulenceImageInfo)
+             .writeImage(3, &DerivativesImageInfo)
+             .writeImage(4, &TurbulenceImageInfo)
+             .writeBuffer(5, &scheduleBufferInfo)
+             .writeBuffer(6, &groupBufferInfo)
+             .build(group.text_merg_desc_set[slot]);
+      }
+   }
+
+   ComputeSystem tex_merg{lveDevice,
+                          {text_merg_desc_lay->getDescriptorSetLayout()},
+                          outputShader("texture_merger"),
+                          {features},
+                          sizeof(lambda_buff)};
+
+   // The fused pipeline runs the vertical FFT of every field in one
+   // workgroup and merges the result there, it needs a row of shared
+   // memory per field. Groups without it fall back to the separate
+   // passes.
+   bool fusedAvailable = false;
+   for (cascade_group &group : groups) {
+      group.fusedAvailable = group.sharedFFT &&
+                             fields * group.size * sizeof(glm::vec4) <=
+                                 limits.maxComputeSharedMemorySize;
+      fusedAvailable = fusedAvailable || group.fusedAvailable;
+   }
+   SimulationSettings simulation;
+   simulation.fusedFFT = fusedAvailable;
+   simulation.phasorEvolution = true;
+   simulation.resetPhase = true;
+   simulation.tickRate = 60;
+   simulation.paused = false;
+   simulation.timeScale = 1.f;
+
+   std::unique_ptr<LveDescriptorSetLayout> fft_merg_desc_lay =
+       LveDescriptorSetLayout::Builder(lveDevice)
+           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .build();
+
+   for (cascade_group &group : groups) {
+      if (!group.fusedAvailable) continue;
+      VkDescriptorImageInfo ping_pong1_ImageInfo =
+          imageInfo(*group.ping_pong1);
+      VkDescriptorImageInfo ping_pong2_ImageInfo =
+          imageInfo(*group.ping_pong2);
+      auto twiddleBufferInfo = group.twiddleBuffer->descriptorInfo();
+      VkDescriptorImageInfo TurbulenceImageInfo =
+          imageInfo(*group.Turbulence);
+      for (size_t slot = 0; slot < simHistory; ++slot) {
+         auto groupBufferInfo = compInfo(*group.compBuffer, slot);
+         VkDescriptorImageInfo Displacement_TurbulenceImageInfo =
+             imageInfo(*group.Displacement_Turbulence[slot]);
+         VkDescriptorImageInfo DerivativesImageInfo =
+             imageInfo(*group.Derivatives[slot]);
+         LveDescriptorWriter(*fft_merg_desc_lay, *computePool)
+             .writeImage(0, &ping_pong1_ImageInfo)
+             .writeImage(1, &ping_pong2_ImageInfo)
+             .writeBuffer(2, &twiddleBufferInfo)
+             .writeImage(3, &Displacement_TurbulenceImageInfo)
+             .writeImage(4, &DerivativesImageInfo)
+             .writeImage(5, &TurbulenceImageInfo)
+             .writeBuffer(6, &scheduleBufferInfo)
+             .writeBuffer(7, &groupBufferInfo)
+             .build(group.fft_merg_desc_set[slot]);
+      }
+
+      uint32_t n = group.size;
+      uint32_t log_n = group.logSize;
+      group.v_fft_merg = std::make_unique<ComputeSystem>(
+          lveDevice,
+          std::vector<VkDescriptorSetLayout>{
+              fft_merg_desc_lay->getDescriptorSetLayout()},
+          outputShader("stockham_fft_merge"),
+          std::vector<uint32_t>{n, log_n, n / 2 / group.butterflies,
+                                group.butterflies, features},
+          sizeof(lambda_buff));
+   }
+
+   std::unique_ptr<LveDescriptorSetLayout> interp_desc_lay =
        LveDescriptorSetLayout::Builder(lveDevice)
            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                        VK_SHADER_STAGE_COMPUTE_BIT)
@@ -805,149 +1395,353 @@ void SecondApp::run() {
                        VK_SHADER_STAGE_COMPUTE_BIT)
            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                        VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
            .build();
 
-   VkDescriptorImageInfo Displacement_TurbulenceImageInfo0 = {
-       .sampler = Displacement_Turbulence0.Sampler,
-       .imageView = Displacement_Turbulence0.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo DerivativesImageInfo0 = {
-       .sampler = Derivatives0.Sampler,
-       .imageView = Derivatives0.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   for (cascade_group &group : groups) {
+      VkDescriptorBufferInfo heldScaleInfo =
+          group.heldScaleBuffer->descriptorInfo();
+      VkDescriptorImageInfo HeldDisplacement_TurbulenceImageInfo =
+          imageInfo(*group.HeldDisplacement_Turbulence);
+      VkDescriptorImageInfo HeldDerivativesImageInfo =
+          imageInfo(*group.HeldDerivatives);
+      for (size_t slot = 0; slot < simHistory; ++slot) {
+         VkDescriptorImageInfo Displacement_TurbulenceImageInfo =
+             imageInfo(*group.Displacement_Turbulence[slot]);
+         VkDescriptorImageInfo DerivativesImageInfo =
+             imageInfo(*group.Derivatives[slot]);
+         auto groupBufferInfo = compInfo(*group.compBuffer, slot);
+         LveDescriptorWriter(*interp_desc_lay, *computePool)
+             .writeImage(0, &Displacement_TurbulenceImageInfo)
+             .writeImage(1, &DerivativesImageInfo)
+             .writeImage(2, &HeldDisplacement_TurbulenceImageInfo)
+             .writeImage(3, &HeldDerivativesImageInfo)
+             .writeBuffer(4, &scheduleBufferInfo)
+             .writeBuffer(5, &groupBufferInfo)
+             .writeBuffer(6, &heldScaleInfo)
+             .build(group.interp_desc_set[slot]);
+      }
+   }
 
-   VkDescriptorImageInfo Displacement_TurbulenceImageInfo1 = {
-       .sampler = Displacement_Turbulence1.Sampler,
-       .imageView = Displacement_Turbulence1.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo DerivativesImageInfo1 = {
-       .sampler = Derivatives1.Sampler,
-       .imageView = Derivatives1.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   ComputeSystem cascade_interp{
+       lveDevice,
+       {interp_desc_lay->getDescriptorSetLayout()},
+       std::string("obj/shaders/cascade_interpolate") +
+           (compact ? "_compact" : "") + ".comp.spv",
+       {features},
+       sizeof(interpolation_buff)};
+
+   // Comparison against an fp32 reference, see precision_error.comp.
+   // Each slot's step writes errorSamples entries per cascade to its own
+   // row, laid out by group, read back once the slot's fence signals.
+   std::unique_ptr<LveBuffer> errorBuffer = std::make_unique<LveBuffer>(
+       lveDevice, sizeof(glm::vec4) * errorSamples * cascades, simHistory,
+       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   errorBuffer->map();
+   auto errorBufferInfo = errorBuffer->descriptorInfo();
 
-   VkDescriptorImageInfo Displacement_TurbulenceImageInfo2 = {
-       .sampler = Displacement_Turbulence2.Sampler,
-       .imageView = Displacement_Turbulence2.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
-   VkDescriptorImageInfo DerivativesImageInfo2 = {
-       .sampler = Derivatives2.Sampler,
-       .imageView = Derivatives2.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-   };
+   std::unique_ptr<LveDescriptorSetLayout> error_desc_lay =
+       LveDescriptorSetLayout::Builder(lveDevice)
+           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .build();
 
-   VkDescriptorImageInfo Displacement_TurbulenceImageInfo3 = {
-       .sampler = Displacement_Turbulence3.Sampler,
-       .imageView = Displacement_Turbulence3.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+   for (cascade_group &group : groups) {
+      VkDescriptorImageInfo PhaseImageInfo = imageInfo(*group.Phase);
+      auto twiddleBufferInfo = group.twiddleBuffer->descriptorInfo();
+      auto bandBufferInfo = group.bandBuffer->descriptorInfo();
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         VkDescriptorImageInfo H0ImageInfo = imageInfo(*group.H0[set]);
+         VkDescriptorImageInfo WavesDataImageInfo =
+             imageInfo(*group.WavesData[set]);
+         for (size_t slot = 0; slot < simHistory; ++slot) {
+            auto groupBufferInfo = compInfo(*group.compBuffer, slot);
+            VkDescriptorImageInfo Displacement_TurbulenceImageInfo =
+                imageInfo(*group.Displacement_Turbulence[slot]);
+            LveDescriptorWriter(*error_desc_lay, *computePool)
+                .writeImage(0, &H0ImageInfo)
+                .writeImage(1, &WavesDataImageInfo)
+                .writeImage(2, &PhaseImageInfo)
+                .writeImage(3, &Displacement_TurbulenceImageInfo)
+                .writeBuffer(4, &twiddleBufferInfo)
+                .writeBuffer(5, &bandBufferInfo)
+                .writeBuffer(6, &errorBufferInfo)
+                .writeBuffer(7, &groupBufferInfo)
+                .build(group.error_desc_set[set][slot]);
+         }
+      }
+   }
+
+   ComputeSystem precision_error{
+       lveDevice,
+       {error_desc_lay->getDescriptorSetLayout()},
+       outputShader("precision_error"),
+       {},
+       sizeof(lambda_buff)};
+
+   // Displacement readback, see readback.comp. Each slot's step writes
+   // the cascades in readbackSlots[slot] to its own region of a
+   // persistently mapped ring, laid out by group, read back once the
+   // slot's fence signals without ever waiting on it.
+   typedef struct {
+      glm::uint32 cascades;
+      glm::uint32 stride;
+      glm::uint32 size;
+      glm::uint32 first;
+   } readback_push;
+   std::vector<uint32_t> readbackFirst(cascades);
+   uint32_t readbackTexelCount = 0;
+   for (uint32_t i = 0; i < cascades; ++i) {
+      // Packed order, so each group's layers follow one another.
+      readbackFirst[i] = 0;
+      for (uint32_t j = 0; j < cascades; ++j) {
+         if (packed(j) < packed(i)) {
+            readbackFirst[i] += readbackSize(j) * readbackSize(j);
+         }
+      }
+      readbackTexelCount += readbackSize(i) * readbackSize(i);
+   }
+   std::unique_ptr<LveBuffer> readbackRing;
+   std::unique_ptr<LveDescriptorSetLayout> readback_desc_lay;
+   std::unique_ptr<ComputeSystem> readbackPass;
+   if (readbackTexels != 0) {
+      readbackRing = std::make_unique<LveBuffer>(
+          lveDevice, sizeof(glm::vec4) * readbackTexelCount, simHistory,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+          lveDevice.properties.limits.nonCoherentAtomSize);
+      readbackRing->map();
+      auto readbackRingInfo = readbackRing->descriptorInfo();
+      readback_desc_lay =
+          LveDescriptorSetLayout::Builder(lveDevice)
+              .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                          VK_SHADER_STAGE_COMPUTE_BIT)
+              .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                          VK_SHADER_STAGE_COMPUTE_BIT)
+              .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                          VK_SHADER_STAGE_COMPUTE_BIT)
+              .build();
+      for (cascade_group &group : groups) {
+         for (size_t slot = 0; slot < simHistory; ++slot) {
+            auto groupBufferInfo = compInfo(*group.compBuffer, slot);
+            VkDescriptorImageInfo Displacement_TurbulenceImageInfo =
+                imageInfo(*group.Displacement_Turbulence[slot]);
+            LveDescriptorWriter(*readback_desc_lay, *computePool)
+                .writeImage(0, &Displacement_TurbulenceImageInfo)
+                .writeBuffer(1, &readbackRingInfo)
+                .writeBuffer(2, &groupBufferInfo)
+                .build(group.readback_desc_set[slot]);
+         }
+      }
+      readbackPass = std::make_unique<ComputeSystem>(
+          lveDevice,
+          std::vector<VkDescriptorSetLayout>{
+              readback_desc_lay->getDescriptorSetLayout()},
+          outputShader("readback"), std::vector<uint32_t>{},
+          sizeof(readback_push));
+   }
+
+   // Indirect dispatch arguments of each slot's step, one set per
+   // group, written on the device by cascade_dispatch.comp.
+   enum : uint32_t {
+      TexelDispatch,
+      RowDispatch,
+      InterpolationDispatch,
+      HRadixDispatch,
+      VRadixDispatch,
+      DispatchesPerStep,
    };
-   VkDescriptorImageInfo DerivativesImageInfo3 = {
-       .sampler = Derivatives3.Sampler,
-       .imageView = Derivatives3.ImageView,
-       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+   std::unique_ptr<LveBuffer> dispatchBuffer = std::make_unique<LveBuffer>(
+       lveDevice, sizeof(VkDispatchIndirectCommand) * DispatchesPerStep,
+       simHistory * groups.size(),
+       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+   auto dispatchBufferInfo = dispatchBuffer->descriptorInfo();
+   auto dispatchIndex = [&](size_t slot, size_t group) {
+      return uint32_t((slot * groups.size() + group) * DispatchesPerStep);
+   };
+   auto dispatchOffset = [&](size_t slot, size_t group,
+                             uint32_t dispatch) {
+      return VkDeviceSize((dispatchIndex(slot, group) + dispatch) *
+                          sizeof(VkDispatchIndirectCommand));
    };
 
-   VkDescriptorSet text_merg_desc_set0 = {};
-   LveDescriptorWriter(*text_merg_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz0ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz0ImageInfo)
-       .writeImage(2, &Displacement_TurbulenceImageInfo0)
-       .writeImage(3, &DerivativesImageInfo0)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(text_merg_desc_set0);
-
-   VkDescriptorSet text_merg_desc_set1 = {};
-   LveDescriptorWriter(*text_merg_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz1ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz1ImageInfo)
-       .writeImage(2, &Displacement_TurbulenceImageInfo1)
-       .writeImage(3, &DerivativesImageInfo1)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(text_merg_desc_set1);
-
-   VkDescriptorSet text_merg_desc_set2 = {};
-   LveDescriptorWriter(*text_merg_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz2ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz2ImageInfo)
-       .writeImage(2, &Displacement_TurbulenceImageInfo2)
-       .writeImage(3, &DerivativesImageInfo2)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(text_merg_desc_set2);
-
-   VkDescriptorSet text_merg_desc_set3 = {};
-   LveDescriptorWriter(*text_merg_desc_lay, *computePool)
-       .writeImage(0, &DxDzDyDxz3ImageInfo)
-       .writeImage(1, &DyxDyzDxxDzz3ImageInfo)
-       .writeImage(2, &Displacement_TurbulenceImageInfo3)
-       .writeImage(3, &DerivativesImageInfo3)
-       .writeBuffer(4, &lambdaBufferInfo)
-       .build(text_merg_desc_set3);
+   std::unique_ptr<LveDescriptorSetLayout> dispatch_desc_lay =
+       LveDescriptorSetLayout::Builder(lveDevice)
+           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .build();
 
-   ComputeSystem tex_merg{lveDevice,
-                          {text_merg_desc_lay->getDescriptorSetLayout()},
-                          "obj/shaders/texture_merger.comp.spv"};
+   VkDescriptorSet dispatch_desc_set = {};
+   LveDescriptorWriter(*dispatch_desc_lay, *computePool)
+       .writeBuffer(0, &dispatchBufferInfo)
+       .build(dispatch_desc_set);
 
-   lambda_buff lamda_buf;
-   lamda_buf.lambda = 1.0f;
+   ComputeSystem cascade_dispatch{
+       lveDevice,
+       {dispatch_desc_lay->getDescriptorSetLayout()},
+       "obj/shaders/cascade_dispatch.comp.spv",
+       {},
+       sizeof(dispatch_buff)};
+
+   // Every per texel pass is 16x16, the shared memory FFT passes take
+   // a row per workgroup. A radix pass workgroup covers local[0] groups
+   // of a line by local[1] / lanes lines, transposed on the vertical
+   // pass.
+   std::vector<dispatch_buff> dispatch_bufs(groups.size());
+   for (size_t g = 0; g < groups.size(); ++g) {
+      uint32_t n = groups[g].size;
+      const uint32_t *local = timed_spec.get_local_size();
+      dispatch_bufs[g].texel_groups = {(n + local[0] - 1) / local[0],
+                                       (n + local[1] - 1) / local[1]};
+      dispatch_bufs[g].row_groups = {0, 0};
+      dispatch_bufs[g].h_radix_groups = {0, 0};
+      dispatch_bufs[g].v_radix_groups = {0, 0};
+      if (groups[g].sharedFFT) {
+         local = groups[g].h_fft->get_local_size();
+         dispatch_bufs[g].row_groups = {1, (n + local[1] - 1) / local[1]};
+      } else {
+         local = groups[g].h_radix->get_local_size();
+         uint32_t radixGroups = n >> groups[g].radixLog;
+         uint32_t lines = local[1] / groups[g].radixLanes;
+         dispatch_bufs[g].h_radix_groups = {
+             (radixGroups + local[0] - 1) / local[0],
+             (n + lines - 1) / lines};
+         dispatch_bufs[g].v_radix_groups = {
+             (n + local[0] - 1) / local[0],
+             (radixGroups + lines - 1) / lines};
+      }
+   }
 
-   MyTextureData* imgs[18];
-   imgs[0] = &buterfly;
-   imgs[1] = &H0K;
-   imgs[2] = &WavesData0;
-   imgs[3] = &WavesData1;
-   imgs[4] = &WavesData2;
-   imgs[5] = &WavesData3;
-   imgs[6] = &H00;
-   imgs[7] = &H01;
-   imgs[8] = &H02;
-   imgs[9] = &H03;
-   imgs[10] = &Displacement_Turbulence0;
-   imgs[11] = &Displacement_Turbulence1;
-   imgs[12] = &Displacement_Turbulence2;
-   imgs[13] = &Displacement_Turbulence3;
-   imgs[14] = &Derivatives0;
-   imgs[15] = &Derivatives1;
-   imgs[16] = &Derivatives2;
-   imgs[17] = &Derivatives3;
+   // Start and end timestamps of every slot's step, for the profiler
+   // overlay, when the queues support them.
+   bool stepTimestamps =
+       lveDevice.properties.limits.timestampComputeAndGraphics;
+   VkQueryPool stepQueries = VK_NULL_HANDLE;
+   bool stepTimed[simHistory] = {};
+   if (stepTimestamps) {
+      VkQueryPoolCreateInfo queryPoolInfo = {
+          .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          .queryType = VK_QUERY_TYPE_TIMESTAMP,
+          .queryCount = 2 * simHistory,
+      };
+      if (vkCreateQueryPool(lveDevice.device(), &queryPoolInfo, nullptr,
+                            &stepQueries) != VK_SUCCESS) {
+         throw std::runtime_error("failed to create step query pool!");
+      }
+   }
+
+   // Default update interval of each cascade, in steps at the default
+   // tick rate: its fastest wave still gets cascadeSamplesPerPeriod
+   // updates per period, and no cascade waits more than
+   // defaultMaxInterval steps.
+   constexpr float cascadeSamplesPerPeriod = 16;
+   constexpr int defaultMaxInterval = 4;
+   simulation.cascadeInterval.resize(cascades);
+   for (uint32_t i = 0; i < cascades; ++i) {
+      float kNyquist =
+          glm::pi<float>() * comp_buf[i].Size / comp_buf[i].LengthScale;
+      float kMax = std::min(comp_buf[i].CutoffHigh, kNyquist);
+      float omega = std::sqrt(comp_buf[i].GravityAcceleration * kMax);
+      float period = 2 * glm::pi<float>() / omega;
+      int steps = static_cast<int>(period / cascadeSamplesPerPeriod *
+                                   simulation.tickRate);
+      simulation.cascadeInterval[i] =
+          std::clamp(steps, 1, defaultMaxInterval);
+      std::cout << "cascade " << i << ": updated every "
+                << simulation.cascadeInterval[i] << " steps\n";
+   }
+   simulation.adaptiveCascades = true;
+   simulation.minCascadePixels = 4.f;
+   simulation.fftPerFrame = 0;
+   simulation.fftPerFrameFull = 0;
+   simulation.stepGpuMs = -1;
+   simulation.activeCascades = 0;
+   simulation.precision = precisionNames[size_t(precision)];
+   simulation.compareFp32 = false;
+   simulation.displacementRms.assign(cascades, -1.f);
+   simulation.displacementMaxError.assign(cascades, -1.f);
+   simulation.displacementReferenceRms.assign(cascades, -1.f);
+   simulation.blendSpectra = false;
+   simulation.blendSeconds = 30.f;
+   simulation.spectrumBlend = 1.f;
+
+   // Order expected by ImGuiGui::update, one row per group, array
+   // textures show every layer.
+   std::vector<std::array<MyTextureData *, 5>> imgs(groups.size());
+   for (size_t g = 0; g < groups.size(); ++g) {
+      imgs[g] = {groups[g].H0K.get(),
+                 groups[g].WavesData[0].get(),
+                 groups[g].H0[0].get(),
+                 groups[g].Displacement_Turbulence[0].get(),
+                 groups[g].Derivatives[0].get()};
+   }
 
    std::unique_ptr<LveDescriptorSetLayout> disp_desc_set_lay =
        LveDescriptorSetLayout::Builder(lveDevice)
            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                        VK_SHADER_STAGE_ALL_GRAPHICS)
            .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       VK_SHADER_STAGE_ALL_GRAPHICS)
+                       VK_SHADER_STAGE_ALL_GRAPHICS, maxCascadeGroups)
            .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       VK_SHADER_STAGE_ALL_GRAPHICS)
+                       VK_SHADER_STAGE_ALL_GRAPHICS, maxCascadeGroups)
            .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       VK_SHADER_STAGE_ALL_GRAPHICS)
+                       VK_SHADER_STAGE_ALL_GRAPHICS, maxCascadeGroups)
            .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       VK_SHADER_STAGE_ALL_GRAPHICS)
-           .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       VK_SHADER_STAGE_ALL_GRAPHICS)
-           .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       VK_SHADER_STAGE_ALL_GRAPHICS)
-           .addBinding(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       VK_SHADER_STAGE_ALL_GRAPHICS)
-           .addBinding(8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                       VK_SHADER_STAGE_ALL_GRAPHICS, maxCascadeGroups)
+           .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                        VK_SHADER_STAGE_ALL_GRAPHICS)
            .build();
 
-   VkDescriptorSet disp_desc_set = {};
-   LveDescriptorWriter(*disp_desc_set_lay, *computePool)
-       .writeBuffer(0, &bufferInfo)
-       .writeImage(1, &Displacement_TurbulenceImageInfo0)
-       .writeImage(2, &DerivativesImageInfo0)
-       .writeImage(3, &Displacement_TurbulenceImageInfo1)
-       .writeImage(4, &DerivativesImageInfo1)
-       .writeImage(5, &Displacement_TurbulenceImageInfo2)
-       .writeImage(6, &DerivativesImageInfo2)
-       .writeImage(7, &Displacement_TurbulenceImageInfo3)
-       .writeImage(8, &DerivativesImageInfo3)
-       .build(disp_desc_set);
+   // Indexed by the latest slot, bindings 3 to 5 hold the step before.
+   // Each binding has one sampler per group, the unused ones repeat the
+   // first group.
+   VkDescriptorSet disp_desc_set[simHistory] = {};
+   for (size_t slot = 0; slot < simHistory; ++slot) {
+      size_t prev = (slot + simHistory - 1) % simHistory;
+      VkDescriptorBufferInfo latestComp = compInfo(*compBuffer, slot);
+      VkDescriptorBufferInfo prevComp = compInfo(*compBuffer, prev);
+      VkDescriptorImageInfo latestDisplacement[maxCascadeGroups];
+      VkDescriptorImageInfo latestDerivatives[maxCascadeGroups];
+      VkDescriptorImageInfo prevDisplacement[maxCascadeGroups];
+      VkDescriptorImageInfo prevDerivatives[maxCascadeGroups];
+      for (size_t g = 0; g < maxCascadeGroups; ++g) {
+         cascade_group &group = groups[g < groups.size() ? g : 0];
+         latestDisplacement[g] =
+             imageInfo(*group.Displacement_Turbulence[slot]);
+         latestDerivatives[g] = imageInfo(*group.Derivatives[slot]);
+         prevDisplacement[g] =
+             imageInfo(*group.Displacement_Turbulence[prev]);
+         prevDerivatives[g] = imageInfo(*group.Derivatives[prev]);
+      }
+      LveDescriptorWriter(*disp_desc_set_lay, *computePool)
+          .writeBuffer(0, &latestComp)
+          .writeImage(1, latestDisplacement, maxCascadeGroups)
+          .writeImage(2, latestDerivatives, maxCascadeGroups)
+          .writeImage(3, prevDisplacement, maxCascadeGroups)
+          .writeImage(4, prevDerivatives, maxCascadeGroups)
+          .writeBuffer(5, &prevComp)
+          .build(disp_desc_set[slot]);
+   }
 
    WaterRenderSystem waterRenderSystem{
        lveDevice,
@@ -957,102 +1751,399 @@ void SecondApp::run() {
        "obj/shaders/water_shader.frag.spv",
        "obj/shaders/water_shader.tesc.spv",
        "obj/shaders/water_shader.tese.spv",
-       disp_desc_set,
+       disp_desc_set[0],
        disp_desc_set_lay->getDescriptorSetLayout()};
 
-   VkCommandBuffer computeCommandBuffer = lveDevice.beginCommandBuffer();
-   timed_spec.dispatch(N, N, 1, timed_spec_desc_set0,
-                       computeCommandBuffer);
-   timed_spec.dispatch(N, N, 1, timed_spec_desc_set1,
-                       computeCommandBuffer);
-   timed_spec.dispatch(N, N, 1, timed_spec_desc_set2,
-                       computeCommandBuffer);
-   timed_spec.dispatch(N, N, 1, timed_spec_desc_set3,
-                       computeCommandBuffer);
-   LvePipeline::barrier(computeCommandBuffer,
-                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-   for (size_t i = 0; i < logN; ++i) {
-      stageBuffer->update(computeCommandBuffer, sizeof(uint32_t), &i);
-      stageBuffer->barrier(
-          computeCommandBuffer, VK_ACCESS_TRANSFER_WRITE_BIT,
-          VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-      VkDescriptorSet desc0_0 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_0 : butterfly_desc_set_2_1_0;
-      VkDescriptorSet desc1_0 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_0 : butterfly_desc_set_2_2_0;
-      h_butterfly.dispatch(N, N, 1, desc0_0, computeCommandBuffer);
-      h_butterfly.dispatch(N, N, 1, desc1_0, computeCommandBuffer);
-      VkDescriptorSet desc0_1 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_1 : butterfly_desc_set_2_1_1;
-      VkDescriptorSet desc1_1 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_1 : butterfly_desc_set_2_2_1;
-      h_butterfly.dispatch(N, N, 1, desc0_1, computeCommandBuffer);
-      h_butterfly.dispatch(N, N, 1, desc1_1, computeCommandBuffer);
-      VkDescriptorSet desc0_2 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_2 : butterfly_desc_set_2_1_2;
-      VkDescriptorSet desc1_2 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_2 : butterfly_desc_set_2_2_2;
-      h_butterfly.dispatch(N, N, 1, desc0_2, computeCommandBuffer);
-      h_butterfly.dispatch(N, N, 1, desc1_2, computeCommandBuffer);
-      VkDescriptorSet desc0_3 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_3 : butterfly_desc_set_2_1_3;
-      VkDescriptorSet desc1_3 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_3 : butterfly_desc_set_2_2_3;
-      h_butterfly.dispatch(N, N, 1, desc0_3, computeCommandBuffer);
-      h_butterfly.dispatch(N, N, 1, desc1_3, computeCommandBuffer);
-      LvePipeline::barrier(computeCommandBuffer,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+   // One command buffer per output slot. The simulation time is pushed
+   // as constants, so a slot is recorded again every time it is
+   // submitted. Every pass is dispatched once per group for all its
+   // cascades, one layer each, and the layers not updated on a step
+   // return right away.
+   QueueFamilyIndices families = lveDevice.findPhysicalQueueFamilies();
+   VkCommandBuffer computeCommandBuffers[simHistory];
+   {
+      VkCommandBufferAllocateInfo allocInfo = {};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.commandPool = lveDevice.getComputeCommandPool();
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocInfo.commandBufferCount = simHistory;
+      if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo,
+                                   computeCommandBuffers) != VK_SUCCESS) {
+         throw std::runtime_error(
+             "failed to allocate simulation command buffers!");
+      }
    }
-   for (size_t i = 0; i < logN; ++i) {
-      stageBuffer->update(computeCommandBuffer, sizeof(uint32_t), &i);
-      stageBuffer->barrier(
-          computeCommandBuffer, VK_ACCESS_TRANSFER_WRITE_BIT,
-          VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-      VkDescriptorSet desc0_0 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_0 : butterfly_desc_set_2_1_0;
-      VkDescriptorSet desc1_0 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_0 : butterfly_desc_set_2_2_0;
-      v_butterfly.dispatch(N, N, 1, desc0_0, computeCommandBuffer);
-      v_butterfly.dispatch(N, N, 1, desc1_0, computeCommandBuffer);
-      VkDescriptorSet desc0_1 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_1 : butterfly_desc_set_2_1_1;
-      VkDescriptorSet desc1_1 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_1 : butterfly_desc_set_2_2_1;
-      v_butterfly.dispatch(N, N, 1, desc0_1, computeCommandBuffer);
-      v_butterfly.dispatch(N, N, 1, desc1_1, computeCommandBuffer);
-      VkDescriptorSet desc0_2 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_2 : butterfly_desc_set_2_1_2;
-      VkDescriptorSet desc1_2 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_2 : butterfly_desc_set_2_2_2;
-      v_butterfly.dispatch(N, N, 1, desc0_2, computeCommandBuffer);
-      v_butterfly.dispatch(N, N, 1, desc1_2, computeCommandBuffer);
-      VkDescriptorSet desc0_3 =
-          i % 2 == 0 ? butterfly_desc_set_1_1_3 : butterfly_desc_set_2_1_3;
-      VkDescriptorSet desc1_3 =
-          i % 2 == 0 ? butterfly_desc_set_1_2_3 : butterfly_desc_set_2_2_3;
-      v_butterfly.dispatch(N, N, 1, desc0_3, computeCommandBuffer);
-      v_butterfly.dispatch(N, N, 1, desc1_3, computeCommandBuffer);
+
+   // Hold a bit per cascade, recordSimulation turns them into the
+   // groups' layer masks.
+   lambda_buff lamda_buf;
+   lamda_buf.lambda = 1.0f;
+   interpolation_buff interp_buf;
+   // Sea state transition, see updateSpectrum. The next step recorded
+   // first bakes the set it leaves into H0Blend when bakePending.
+   float spectrumBlend = 1.f;
+   bool bakePending = false;
+   size_t bakeSpectrum = 0;
+   float bakeWeight = 1.f;
+   // Hybrid split. The cascades in cpuSlotCascades[slot] skip the step
+   // and are copied into the slot's outputs from a CpuOcean instead,
+   // through a persistently mapped staging ring with a region per slot.
+   // A step starts the CPU job of the next one when none is running, so
+   // it runs while the frame in between is drawn. The steps never wait
+   // for it: the outputs of the last finished job are packed into
+   // cpuHeld, and every step copies them until the next one finishes.
+   const bool hybridOn = hybrid && !compact;
+   if (hybrid && !hybridOn) {
+      std::cout << "the hybrid split needs fp16 outputs, simulating "
+                   "every cascade on the GPU\n";
+   }
+   static_assert(sizeof(SpectrumParameters) ==
+                 sizeof(CpuSpectrumParameters));
+   std::unique_ptr<CpuOcean> cpuOcean;
+   std::unique_ptr<LveBuffer> cpuStaging;
+   std::vector<VkDeviceSize> cpuStagingOffsets(cascades);
+   std::vector<char> cpuHeld;
+   // CPU milliseconds per unit of cascadeCost, averaged over the jobs.
+   float cpuMsPerCost = -1;
+   auto cascadeCost = [&](uint32_t i) {
+      float n = comp_buf[i].Size;
+      return n * n * std::log2(n);
+   };
+   std::vector<CpuCascadeSettings> cpuSettings;
+   for (uint32_t i = 0; i < cascades; ++i) {
+      cpuSettings.push_back({comp_buf[i].LengthScale, comp_buf[i].CutoffHigh,
+                             comp_buf[i].CutoffLow,
+                             comp_buf[i].GravityAcceleration,
+                             comp_buf[i].Depth, comp_buf[i].Size});
+   }
+   if (hybridOn) {
+      cpuOcean = std::make_unique<CpuOcean>(cpuSettings, features);
+      VkDeviceSize region = 0;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         const cascade_group &group = groups[comp_buf[i].Group];
+         cpuStagingOffsets[i] = region;
+         region += cpuStagingBytes(*cpuOcean, i,
+                                   *group.Displacement_Turbulence[0],
+                                   *group.Derivatives[0]);
+      }
+      cpuHeld.resize(region);
+      cpuStaging = std::make_unique<LveBuffer>(
+          lveDevice, region, simHistory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+          lveDevice.properties.limits.nonCoherentAtomSize);
+      cpuStaging->map();
+
+      // Calibrates the cost model on the smallest cascade, so the policy
+      // can predict the first cascade it moves.
+      CpuSpectrumParameters spectrum[2];
+      std::memcpy(spectrum, spec_params, sizeof(spectrum));
+      cpuOcean->initSpectrum(spectrum);
+      uint32_t smallest = 0;
+      for (uint32_t i = 1; i < cascades; ++i) {
+         if (cascadeCost(i) < cascadeCost(smallest)) smallest = i;
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      cpuOcean->step(std::vector<double>(cascades), 0.f, lamda_buf.lambda,
+                     1u << smallest);
+      cpuMsPerCost =
+          std::chrono::duration<float, std::milli>(
+              std::chrono::high_resolution_clock::now() - start)
+              .count() /
+          cascadeCost(smallest);
+   }
+   simulation.readbackAvailable = readbackPass != nullptr;
+   simulation.readbackCascades =
+       readbackPass ? (cascades < 32 ? 1u << cascades : 0u) - 1 : 0;
+   simulation.compareCpu = false;
+   simulation.cpuRms.assign(cascades, -1.f);
+   simulation.cpuMaxError.assign(cascades, -1.f);
+   simulation.hybridAvailable = hybridOn;
+   simulation.hybridAuto = hybridOn;
+   simulation.cpuCascades = 0;
+   simulation.cpuStepMs = -1;
+   // The running job, the cascades it steps, those cpuHeld holds, and
+   // the spectrum the next job initializes first when
+   // cpuSpectrumPending.
+   std::future<float> cpuJob;
+   uint32_t cpuJobCascades = 0;
+   uint32_t cpuHeldCascades = 0;
+   // Time the last job stepped to, negative before the first.
+   double cpuJobTime = -1;
+   CpuSpectrumParameters cpuSpectrum[2];
+   bool cpuSpectrumPending = false;
+   uint32_t cpuSlotCascades[simHistory] = {};
+   // The cascades each slot's step reads back, until collected, and the
+   // step's tick and time.
+   uint32_t readbackSlots[simHistory] = {};
+   uint64_t readbackTick[simHistory] = {};
+   double readbackTime[simHistory] = {};
+   // With compareCpu, the cascades of each slot's readback the GPU
+   // computed at the step, neither interpolated nor from the CPU, and
+   // those of the latest snapshot with any, until compared.
+   uint32_t readbackComputed[simHistory] = {};
+   uint64_t compareTick = 0;
+   uint32_t compareCascades = 0;
+   auto startCpuJob = [&](std::vector<double> times, float dt,
+                          uint32_t mask) {
+      CpuOcean *ocean = cpuOcean.get();
+      bool init = cpuSpectrumPending;
+      CpuSpectrumParameters spectrum[2];
+      std::memcpy(spectrum, cpuSpectrum, sizeof(spectrum));
+      float lambda = lamda_buf.lambda;
+      cpuSpectrumPending = false;
+      cpuJobCascades = mask;
+      cpuJob = std::async(std::launch::async, [=]() {
+         if (init) ocean->initSpectrum(spectrum);
+         auto start = std::chrono::high_resolution_clock::now();
+         ocean->step(times, dt, lambda, mask);
+         return std::chrono::duration<float, std::milli>(
+                    std::chrono::high_resolution_clock::now() - start)
+             .count();
+      });
+   };
+   auto recordSimulation = [&](size_t slot) {
+      VkCommandBuffer computeCommandBuffer = computeCommandBuffers[slot];
+      VkCommandBufferBeginInfo beginInfo = {};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      vkBeginCommandBuffer(computeCommandBuffer, &beginInfo);
+      ComputeSystem::forget_bindings();
+      // Orders this step after the previous one on the compute queue,
+      // they share every intermediate texture.
+      LvePipeline::barrier(
+          computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+      // Only the water shaders read it, after computeFinished.
+      compBuffer->update(computeCommandBuffer, sizeof(comp_ubo) * cascades,
+                         comp_buf.data(),
+                         slot * compBuffer->getAlignmentSize());
+      if (stepTimestamps) {
+         vkCmdResetQueryPool(computeCommandBuffer, stepQueries, 2 * slot,
+                             2);
+         vkCmdWriteTimestamp(computeCommandBuffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             stepQueries, 2 * slot);
+      }
+      if (bakePending) {
+         for (cascade_group &group : groups) {
+            blend_spec.dispatch(group.size, group.size,
+                                group.cascades.size(),
+                                group.blend_spec_desc_set[bakeSpectrum],
+                                computeCommandBuffer, &bakeWeight);
+         }
+         LvePipeline::barrier(computeCommandBuffer,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+         bakePending = false;
+      }
+      lamda_buf.spectrum_blend = spectrumBlend;
+      for (size_t g = 0; g < groups.size(); ++g) {
+         dispatch_buff &dispatch_buf = dispatch_bufs[g];
+         dispatch_buf.cascades = layerMask(groups[g], lamda_buf.cascades);
+         dispatch_buf.interpolated =
+             layerMask(groups[g], interp_buf.cascades);
+         dispatch_buf.first = dispatchIndex(slot, g);
+         cascade_dispatch.dispatch(1, 1, 1, dispatch_desc_set,
+                                   computeCommandBuffer, &dispatch_buf);
+      }
       LvePipeline::barrier(computeCommandBuffer,
                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-   }
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_1_0, computeCommandBuffer);
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_2_0, computeCommandBuffer);
-   tex_merg.dispatch(N, N, 1, text_merg_desc_set0, computeCommandBuffer);
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_1_1, computeCommandBuffer);
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_2_1, computeCommandBuffer);
-   tex_merg.dispatch(N, N, 1, text_merg_desc_set1, computeCommandBuffer);
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_1_2, computeCommandBuffer);
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_2_2, computeCommandBuffer);
-   tex_merg.dispatch(N, N, 1, text_merg_desc_set2, computeCommandBuffer);
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_1_3, computeCommandBuffer);
-   perm_inv.dispatch(N, N, 1, perm_inv_desc_set_2_3, computeCommandBuffer);
-   tex_merg.dispatch(N, N, 1, text_merg_desc_set3, computeCommandBuffer);
-   lveDevice.endCommandBuffer(computeCommandBuffer);
+                           VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                           VK_ACCESS_SHADER_WRITE_BIT,
+                           VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+      VkBuffer args = dispatchBuffer->getBuffer();
+      for (size_t g = 0; g < groups.size(); ++g) {
+         cascade_group &group = groups[g];
+         lambda_buff step = lamda_buf;
+         step.cascades = layerMask(group, lamda_buf.cascades);
+         step.schedule = lamda_buf.schedule + group.first;
+         interpolation_buff interp = {
+             layerMask(group, interp_buf.cascades),
+             interp_buf.schedule + group.first};
+         if (step.cascades == 0 && interp.cascades == 0) continue;
+         uint32_t logN = group.logSize;
+         VkDeviceSize texelArgs = dispatchOffset(slot, g, TexelDispatch);
+         VkDeviceSize rowArgs = dispatchOffset(slot, g, RowDispatch);
+         bool fused = group.fusedAvailable && simulation.fusedFFT;
+         fft_buff spectrum = {fused, step.cascades};
+         ComputeSystem &timed = fused ? timed_spec_shifted : timed_spec;
+         timed.dispatchIndirect(args, texelArgs,
+                                group.timed_spec_desc_set[frontSpectrum],
+                                computeCommandBuffer, &step);
+         LvePipeline::barrier(computeCommandBuffer,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+         if (fused) {
+            for (size_t field = 0; field < fields; ++field) {
+               group.h_fft->dispatchIndirect(
+                   args, rowArgs, group.butterfly_desc_sets[0][field],
+                   computeCommandBuffer, &spectrum);
+            }
+            LvePipeline::barrier(computeCommandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            group.v_fft_merg->dispatchIndirect(
+                args, rowArgs, group.fft_merg_desc_set[slot],
+                computeCommandBuffer, &step);
+         } else if (group.sharedFFT) {
+            for (size_t field = 0; field < fields; ++field) {
+               group.h_fft->dispatchIndirect(
+                   args, rowArgs, group.butterfly_desc_sets[0][field],
+                   computeCommandBuffer, &spectrum);
+            }
+            LvePipeline::barrier(computeCommandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            for (size_t field = 0; field < fields; ++field) {
+               group.v_fft->dispatchIndirect(
+                   args, rowArgs, group.butterfly_desc_sets[1][field],
+                   computeCommandBuffer, &spectrum);
+            }
+            LvePipeline::barrier(computeCommandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+         } else {
+            // Radix passes while radixLog stages are left, then one
+            // stage per pass. The parity follows the pass count across
+            // both directions, which is even, so the result ends up
+            // back in the spectrum textures.
+            size_t pass = 0;
+            for (uint32_t vertical = 0; vertical < 2; ++vertical) {
+               for (uint32_t s = 0; s < logN;) {
+                  butterfly_buff stage = {glm::int32(s), step.cascades};
+                  ComputeSystem *butterfly =
+                      vertical ? &v_butterfly : &h_butterfly;
+                  VkDeviceSize passArgs = texelArgs;
+                  if (logN - s >= group.radixLog) {
+                     butterfly = vertical ? group.v_radix.get()
+                                          : group.h_radix.get();
+                     passArgs = dispatchOffset(
+                         slot, g, vertical ? VRadixDispatch : HRadixDispatch);
+                     s += group.radixLog;
+                  } else {
+                     s += 1;
+                  }
+                  for (size_t field = 0; field < fields; ++field) {
+                     butterfly->dispatchIndirect(
+                         args, passArgs,
+                         group.butterfly_desc_sets[pass % 2][field],
+                         computeCommandBuffer, &stage);
+                  }
+                  LvePipeline::barrier(computeCommandBuffer,
+                                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                  ++pass;
+               }
+            }
+         }
+         if (!fused) {
+            for (size_t field = 0; field < fields; ++field) {
+               perm_inv.dispatchIndirect(
+                   args, texelArgs, group.perm_inv_desc_sets[field],
+                   computeCommandBuffer, &step.cascades);
+            }
+            LvePipeline::barrier(computeCommandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            tex_merg.dispatchIndirect(args, texelArgs,
+                                      group.text_merg_desc_set[slot],
+                                      computeCommandBuffer, &step);
+         }
+         // The reference knows nothing of H0Blend, so it waits for the
+         // transitions to end.
+         if (simulation.compareFp32 && step.cascades != 0 &&
+             spectrumBlend >= 1.f) {
+            LvePipeline::barrier(computeCommandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            precision_error.dispatch(
+                errorSamples * precision_error.get_local_size()[0], 1,
+                group.cascades.size(),
+                group.error_desc_set[frontSpectrum][slot],
+                computeCommandBuffer, &step);
+         }
+         if (interp.cascades != 0) {
+            LvePipeline::barrier(computeCommandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            cascade_interp.dispatchIndirect(
+                args, dispatchOffset(slot, g, InterpolationDispatch),
+                group.interp_desc_set[slot], computeCommandBuffer,
+                &interp);
+         }
+      }
+      if (cpuSlotCascades[slot] != 0) {
+         VkDeviceSize base = slot * cpuStaging->getAlignmentSize();
+         for (uint32_t i = 0; i < cascades; ++i) {
+            if ((cpuSlotCascades[slot] & (1u << i)) == 0) continue;
+            cascade_group &group = groups[comp_buf[i].Group];
+            VkDeviceSize offset = base + cpuStagingOffsets[i];
+            VkDeviceSize bytes = i + 1 < cascades
+                                     ? cpuStagingOffsets[i + 1] -
+                                           cpuStagingOffsets[i]
+                                     : cpuHeld.size() - cpuStagingOffsets[i];
+            std::memcpy(
+                static_cast<char *>(cpuStaging->getMappedMemory()) + offset,
+                cpuHeld.data() + cpuStagingOffsets[i], bytes);
+            recordCpuCopy(*cpuOcean, i, *group.Displacement_Turbulence[slot],
+                          *group.Derivatives[slot], comp_buf[i].Layer,
+                          computeCommandBuffer, cpuStaging->getBuffer(),
+                          offset);
+         }
+         cpuStaging->flushIndex(slot);
+      }
+      if (readbackSlots[slot] != 0) {
+         LvePipeline::barrier(computeCommandBuffer,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+         uint32_t slotFirst = uint32_t(
+             slot * readbackRing->getAlignmentSize() / sizeof(glm::vec4));
+         for (cascade_group &group : groups) {
+            readback_push push;
+            push.cascades = layerMask(group, readbackSlots[slot]);
+            if (push.cascades == 0) continue;
+            push.size = readbackSize(group.cascades[0]);
+            push.stride = group.size / push.size;
+            push.first = slotFirst + readbackFirst[group.cascades[0]];
+            readbackPass->dispatch(push.size, push.size,
+                                   group.cascades.size(),
+                                   group.readback_desc_set[slot],
+                                   computeCommandBuffer, &push);
+         }
+         LvePipeline::barrier(computeCommandBuffer,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_HOST_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_ACCESS_HOST_READ_BIT);
+      }
+      // Hand the outputs to the graphics queue. They are not handed
+      // back, the next step on this slot overwrites them.
+      for (cascade_group &group : groups) {
+         for (MyTextureData *output :
+              {group.Displacement_Turbulence[slot].get(),
+               group.Derivatives[slot].get()}) {
+            lveDevice.releaseImageOwnership(
+                computeCommandBuffer, output->Image, group.cascades.size(),
+                families.computeFamily, families.graphicsFamily,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT);
+         }
+      }
+      if (simulation.compareFp32) {
+         LvePipeline::barrier(computeCommandBuffer,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_HOST_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_ACCESS_HOST_READ_BIT);
+      }
+      if (stepTimestamps) {
+         vkCmdWriteTimestamp(computeCommandBuffer,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             stepQueries, 2 * slot + 1);
+      }
+      lveDevice.endCommandBuffer(computeCommandBuffer);
+   };
 
    float time = 0;
    float angle = 3.15;
@@ -1061,17 +2152,705 @@ void SecondApp::run() {
        {0.0f, 0.11764705882f, 1.0f, 1.0f},
        {0.0f, 0.0f, 1.0f, 1.0f}};
 
-   VkFence Fence;
+   // A slot goes around Free/Released -> Computing -> Rendering ->
+   // Released. computeFinished[slot] hands a finished step to the next
+   // frame, outputReleased[slot] is signaled by the first frame that no
+   // longer samples the slot. A semaphore signal covers all the work
+   // submitted before it on the queue, so it also covers the frames that
+   // did sample it. computeFences guard recording a slot's command
+   // buffer again, and tell frames which steps have finished.
+   enum class SlotState { Free, Computing, Rendering, Released };
+   VkSemaphore computeFinished[simHistory];
+   VkSemaphore outputReleased[simHistory];
+   VkFence computeFences[simHistory];
+   SlotState slotState[simHistory];
+   VkSemaphoreCreateInfo SemaphoreCreateInfo = {
+       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+   };
    VkFenceCreateInfo FenceCreateInfo = {
        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
        .pNext = nullptr,
-       .flags = 0,
+       .flags = VK_FENCE_CREATE_SIGNALED_BIT,
    };
-   if (vkCreateFence(lveDevice.device(), &FenceCreateInfo, nullptr,
-                     &Fence)) {
-      throw std::runtime_error("failed to create pipeline layout!");
+   for (size_t slot = 0; slot < simHistory; ++slot) {
+      slotState[slot] = SlotState::Free;
+      if (vkCreateSemaphore(lveDevice.device(), &SemaphoreCreateInfo,
+                            nullptr, &computeFinished[slot]) ||
+          vkCreateSemaphore(lveDevice.device(), &SemaphoreCreateInfo,
+                            nullptr, &outputReleased[slot]) ||
+          vkCreateFence(lveDevice.device(), &FenceCreateInfo, nullptr,
+                        &computeFences[slot])) {
+         throw std::runtime_error(
+             "failed to create simulation synchronization objects!");
+      }
    }
 
+   // Scheduling state of a cascade between its updates. It is updated
+   // on the steps where (tick + phase) % interval is 0.
+   typedef struct {
+      uint32_t interval;
+      uint32_t phase;
+      // Phasor ticks and time not applied to the cascade yet, and the
+      // ticks since its phasors were last reset to exp(i 0), those
+      // included.
+      uint32_t ticks;
+      float time;
+      uint64_t phasorTicks;
+      uint32_t ticksSinceRenormalize;
+      uint32_t stepsSinceUpdate;
+      // Held layer of the latest update, when heldValid.
+      uint32_t newest;
+      bool heldValid;
+      bool reset;
+      bool computed;
+   } cascade_schedule;
+   std::vector<cascade_schedule> schedules(cascades, cascade_schedule{});
+   std::vector<cascade_step> cascadeSteps(cascades);
+   // The same entries laid out by group, as the shaders read them.
+   std::vector<cascade_step> packedSteps(cascades);
+
+   // Spreads the updates of the slower cascades so every step costs
+   // about the same: slowest first, each cascade takes the phase whose
+   // steps are the least loaded so far over the schedule period.
+   auto staggerCascades = [&]() {
+      uint32_t period = 1;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         schedules[i].interval =
+             std::max(simulation.cascadeInterval[i], 1);
+         period = std::lcm(period, schedules[i].interval);
+      }
+      std::vector<uint32_t> order(cascades);
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(),
+                       [&](uint32_t a, uint32_t b) {
+                          return schedules[a].interval >
+                                 schedules[b].interval;
+                       });
+      std::vector<uint32_t> load(period, 0);
+      for (uint32_t i : order) {
+         uint32_t interval = schedules[i].interval;
+         uint32_t best = 0;
+         uint32_t bestPeak = uint32_t(-1);
+         for (uint32_t phase = 0; phase < interval; ++phase) {
+            uint32_t peak = 0;
+            for (uint32_t t = interval - phase; t <= period;
+                 t += interval) {
+               peak = std::max(peak, load[t % period]);
+            }
+            if (peak < bestPeak) {
+               best = phase;
+               bestPeak = peak;
+            }
+         }
+         for (uint32_t t = interval - best; t <= period; t += interval) {
+            ++load[t % period];
+         }
+         schedules[i].phase = best;
+      }
+   };
+   staggerCascades();
+
+   float phasorTime = 0;
+   // Cascade FFTs submitted since the last frame, for the GUI.
+   size_t cascadeUpdates = 0;
+   // Cascades simulated from now on, and the ones each slot's output
+   // holds.
+   uint32_t visibleCascades = (cascades < 32 ? 1u << cascades : 0u) - 1;
+   uint32_t slotCascades[simHistory] = {};
+   // Cascades checked by precision_error.comp on each slot's step.
+   uint32_t slotCompared[simHistory] = {};
+   // Publishes the readbacks of the steps submitted before tick, oldest
+   // first, up to the first one still running.
+   uint64_t readbackNext = 0;
+   auto collectReadbacks = [&](uint64_t tick) {
+      for (; readbackNext < tick; ++readbackNext) {
+         size_t slot = readbackNext % simHistory;
+         if (readbackSlots[slot] == 0) continue;
+         if (vkGetFenceStatus(lveDevice.device(), computeFences[slot]) !=
+             VK_SUCCESS) {
+            return;
+         }
+         uint32_t mask = readbackSlots[slot];
+         readbackSlots[slot] = 0;
+         // Readers hold every snapshot, this one is dropped.
+         OceanSnapshot *snapshot = readback.writable();
+         if (!snapshot) continue;
+         readbackRing->invalidateIndex(slot);
+         const glm::vec4 *texels =
+             static_cast<const glm::vec4 *>(readbackRing->getMappedMemory()) +
+             slot * readbackRing->getAlignmentSize() / sizeof(glm::vec4);
+         snapshot->tick = readbackTick[slot];
+         snapshot->time = readbackTime[slot];
+         snapshot->cascades = mask;
+         snapshot->data.resize(cascades);
+         for (uint32_t i = 0; i < cascades; ++i) {
+            OceanSnapshot::Cascade &cascade = snapshot->data[i];
+            cascade.lengthScale = comp_buf[i].LengthScale;
+            cascade.size = readbackSize(i);
+            if ((mask & (1u << i)) == 0) continue;
+            const glm::vec4 *first = texels + readbackFirst[i];
+            cascade.texels.assign(first,
+                                  first + cascade.size * cascade.size);
+         }
+         readback.publish(snapshot);
+         if (readbackComputed[slot] & mask) {
+            compareTick = snapshot->tick;
+            compareCascades = readbackComputed[slot] & mask;
+         }
+      }
+   };
+   // Moves one cascade at a time between the CPU and the GPU, from the
+   // step timings. The CPU takes the cascade saving the GPU the most
+   // while its step, predicted by cascadeCost, stays under half a tick
+   // and under what is left of the GPU step, and gives back its largest
+   // cascade once its step goes over 80% of a tick. Without GPU
+   // timestamps there is nothing to balance against.
+   constexpr uint64_t hybridPeriod = 60;
+   auto balanceHybrid = [&]() {
+      float tickMs = 1000.f / simulation.tickRate;
+      uint32_t &onCpu = simulation.cpuCascades;
+      auto interval = [&](uint32_t i) {
+         return float(std::max(simulation.cascadeInterval[i], 1));
+      };
+      if (onCpu != 0 && simulation.cpuStepMs > 0.8f * tickMs) {
+         uint32_t largest = cascades;
+         for (uint32_t i = 0; i < cascades; ++i) {
+            if ((onCpu & (1u << i)) == 0) continue;
+            if (largest == cascades ||
+                cascadeCost(i) > cascadeCost(largest)) {
+               largest = i;
+            }
+         }
+         onCpu &= ~(1u << largest);
+         simulation.cpuStepMs = -1;
+         return;
+      }
+      if (simulation.stepGpuMs < 0 || cpuMsPerCost < 0) return;
+      float cpuCost = 0, gpuCost = 0;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         if ((visibleCascades & (1u << i)) == 0) continue;
+         if (onCpu & (1u << i)) {
+            cpuCost += cascadeCost(i);
+         } else {
+            gpuCost += cascadeCost(i) / interval(i);
+         }
+      }
+      uint32_t best = cascades;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         if ((visibleCascades & (1u << i)) == 0 || (onCpu & (1u << i))) {
+            continue;
+         }
+         float cpuMs = cpuMsPerCost * (cpuCost + cascadeCost(i));
+         float gpuMs = simulation.stepGpuMs *
+                       (1.f - cascadeCost(i) / interval(i) / gpuCost);
+         if (cpuMs > 0.5f * tickMs || cpuMs > gpuMs) continue;
+         if (best == cascades || cascadeCost(i) / interval(i) >
+                                     cascadeCost(best) / interval(best)) {
+            best = i;
+         }
+      }
+      if (best == cascades) return;
+      onCpu |= 1u << best;
+      simulation.cpuStepMs = -1;
+   };
+   auto submitSimulation = [&](uint64_t tick, float simTime, float dt) {
+      size_t slot = tick % simHistory;
+      vkWaitForFences(lveDevice.device(), 1, &computeFences[slot], true,
+                      uint64_t(-1));
+      collectReadbacks(tick);
+      if (slotCompared[slot] != 0) {
+         errorBuffer->invalidate();
+         const glm::vec4 *errors =
+             static_cast<const glm::vec4 *>(errorBuffer->getMappedMemory()) +
+             slot * cascades * errorSamples;
+         for (uint32_t i = 0; i < cascades; ++i) {
+            if ((slotCompared[slot] & (1u << i)) == 0) continue;
+            const glm::vec4 *samples = errors + packed(i) * errorSamples;
+            float squared = 0, maxError = 0, reference = 0;
+            for (uint32_t k = 0; k < errorSamples; ++k) {
+               float error = glm::length(glm::vec3(samples[k]));
+               squared += error * error;
+               maxError = std::max(maxError, error);
+               reference += samples[k].w * samples[k].w;
+            }
+            simulation.displacementRms[i] =
+                std::sqrt(squared / errorSamples);
+            simulation.displacementMaxError[i] = maxError;
+            simulation.displacementReferenceRms[i] =
+                std::sqrt(reference / errorSamples);
+         }
+      }
+      if (stepTimed[slot]) {
+         uint64_t stamps[2];
+         if (vkGetQueryPoolResults(lveDevice.device(), stepQueries,
+                                   2 * slot, 2, sizeof(stamps), stamps,
+                                   sizeof(uint64_t),
+                                   VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            float ms = (stamps[1] - stamps[0]) *
+                       lveDevice.properties.limits.timestampPeriod / 1e6f;
+            simulation.stepGpuMs =
+                simulation.stepGpuMs < 0
+                    ? ms
+                    : glm::mix(simulation.stepGpuMs, ms, 0.05f);
+         }
+      }
+      // The CPU's share of this step: what the last finished job computed
+      // of the cascades still wanted there. Until a cascade's first job
+      // finishes the GPU goes on simulating it.
+      if (cpuJob.valid() && cpuJob.wait_for(std::chrono::seconds(0)) ==
+                                std::future_status::ready) {
+         float ms = cpuJob.get();
+         simulation.cpuStepMs = simulation.cpuStepMs < 0
+                                    ? ms
+                                    : glm::mix(simulation.cpuStepMs, ms,
+                                               0.05f);
+         float cost = 0;
+         for (uint32_t i = 0; i < cascades; ++i) {
+            if (cpuJobCascades & (1u << i)) cost += cascadeCost(i);
+         }
+         cpuMsPerCost = glm::mix(cpuMsPerCost, ms / cost, 0.05f);
+         for (uint32_t i = 0; i < cascades; ++i) {
+            if ((cpuJobCascades & (1u << i)) == 0) continue;
+            const cascade_group &group = groups[comp_buf[i].Group];
+            packCpuOutputs(*cpuOcean, i, *group.Displacement_Turbulence[0],
+                           *group.Derivatives[0],
+                           cpuHeld.data() + cpuStagingOffsets[i]);
+         }
+         cpuHeldCascades = cpuJobCascades;
+      }
+      uint32_t cpuStep =
+          cpuHeldCascades & simulation.cpuCascades & visibleCascades;
+      lamda_buf.time = simTime;
+      lamda_buf.delta_time = dt;
+      lamda_buf.tick = phasorTick;
+      lamda_buf.flags = 0;
+      uint32_t ticks = 0;
+      if (!simulation.phasorEvolution) {
+         // Start over from exp(i 0) when it is turned back on.
+         simulation.resetPhase = true;
+      } else if (simulation.resetPhase) {
+         lamda_buf.flags = PhasorEvolution;
+         simulation.resetPhase = false;
+         phasorTime = 0;
+         for (cascade_schedule &schedule : schedules) {
+            schedule.reset = true;
+            schedule.ticks = 0;
+            schedule.phasorTicks = 0;
+            schedule.ticksSinceRenormalize = 0;
+         }
+      } else {
+         phasorTime += dt;
+         ticks = static_cast<uint32_t>(phasorTime / phasorTick);
+         // Steps longer than the cap are dropped, not caught up.
+         ticks = std::min(ticks, phasorMaxTicks);
+         phasorTime = std::min(phasorTime - ticks * phasorTick,
+                               phasorTick);
+         lamda_buf.flags = PhasorEvolution;
+      }
+
+      for (uint32_t i = 0; i < cascades; ++i) {
+         if (schedules[i].interval !=
+             uint32_t(std::max(simulation.cascadeInterval[i], 1))) {
+            staggerCascades();
+            break;
+         }
+      }
+      lamda_buf.cascades = 0;
+      lamda_buf.schedule = slot * cascades;
+      interp_buf.cascades = 0;
+      interp_buf.schedule = lamda_buf.schedule;
+      for (uint32_t i = 0; i < cascades; ++i) {
+         cascade_schedule &schedule = schedules[i];
+         cascade_step &step = cascadeSteps[i];
+         step = {};
+         bool cpu = cpuStep & (1u << i);
+         if ((visibleCascades & (1u << i)) == 0 || cpu) {
+            // Its output goes stale or comes from the CPU, start over
+            // when the steps simulate it again. The CPU goes on from the
+            // phasors' ticks, which the next update catches up on.
+            cascade_schedule kept = schedule;
+            schedule = {schedule.interval, schedule.phase};
+            schedule.reset = true;
+            if (cpu) {
+               schedule.reset = kept.reset;
+               schedule.ticks = kept.ticks + ticks;
+               schedule.phasorTicks = kept.phasorTicks + ticks;
+               schedule.ticksSinceRenormalize = kept.ticksSinceRenormalize;
+            }
+            continue;
+         }
+         schedule.ticks += ticks;
+         schedule.phasorTicks += ticks;
+         schedule.time += dt;
+         ++schedule.stepsSinceUpdate;
+         // Nothing to hold before a cascade's first update.
+         bool update = !schedule.computed ||
+                       (tick + schedule.phase) % schedule.interval == 0;
+         if (update) {
+            lamda_buf.cascades |= 1u << i;
+            step.ticks = schedule.ticks;
+            step.delta_time = schedule.time;
+            schedule.ticksSinceRenormalize += schedule.ticks;
+            if (schedule.reset) {
+               step.flags |= PhasorReset;
+               schedule.reset = false;
+            }
+            if (schedule.ticksSinceRenormalize >= phasorRenormalizeTicks) {
+               step.flags |= PhasorRenormalize;
+               schedule.ticksSinceRenormalize = 0;
+            }
+            schedule.ticks = 0;
+            schedule.time = 0;
+            schedule.stepsSinceUpdate = 0;
+            schedule.computed = true;
+         }
+         if (schedule.interval == 1) {
+            schedule.heldValid = false;
+            continue;
+         }
+         interp_buf.cascades |= 1u << i;
+         if (update) {
+            step.flags |= CascadeUpdated;
+            if (!schedule.heldValid) step.flags |= CascadeRestart;
+            schedule.newest = 1 - schedule.newest;
+            schedule.heldValid = true;
+         }
+         step.newest = schedule.newest;
+         step.blend = std::min(
+             1.f, float(schedule.stepsSinceUpdate) / schedule.interval);
+      }
+      cpuSlotCascades[slot] = cpuStep;
+      slotCascades[slot] =
+          lamda_buf.cascades | interp_buf.cascades | cpuStep;
+      if (readbackPass) {
+         readbackSlots[slot] = simulation.readbackCascades & slotCascades[slot];
+         readbackTick[slot] = tick;
+         readbackTime[slot] = simTime;
+         // The CPU only matches the steps with phasor evolution off and
+         // outside of sea state transitions.
+         readbackComputed[slot] =
+             simulation.compareCpu && !simulation.phasorEvolution &&
+                     spectrumBlend == 1.f
+                 ? lamda_buf.cascades & ~interp_buf.cascades
+                 : 0;
+      }
+      for (uint32_t i = 0; i < cascades; ++i) {
+         packedSteps[packed(i)] = cascadeSteps[i];
+      }
+      scheduleBuffer->writeToIndex(packedSteps.data(), slot);
+      scheduleBuffer->flush();
+      if (compact) writeCascadeBuffers(slot);
+      cascadeUpdates += std::bitset<32>(lamda_buf.cascades).count();
+      slotCompared[slot] = simulation.compareFp32 ? lamda_buf.cascades : 0;
+      recordSimulation(slot);
+      stepTimed[slot] = stepTimestamps;
+
+      VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                       VK_PIPELINE_STAGE_TRANSFER_BIT;
+      VkSubmitInfo submitInfo = {};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      if (slotState[slot] == SlotState::Released) {
+         submitInfo.waitSemaphoreCount = 1;
+         submitInfo.pWaitSemaphores = &outputReleased[slot];
+         submitInfo.pWaitDstStageMask = &waitStage;
+      }
+      slotState[slot] = SlotState::Computing;
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &computeCommandBuffers[slot];
+      submitInfo.signalSemaphoreCount = 1;
+      submitInfo.pSignalSemaphores = &computeFinished[slot];
+      vkResetFences(lveDevice.device(), 1, &computeFences[slot]);
+      if (vkQueueSubmit(lveDevice.computeQueue(), 1, &submitInfo,
+                        computeFences[slot]) != VK_SUCCESS) {
+         throw std::runtime_error("failed to submit ocean simulation!");
+      }
+
+      if (!cpuOcean) return;
+      if (simulation.hybridAuto && tick % hybridPeriod == 0) {
+         balanceHybrid();
+      }
+      uint32_t cpuNext = simulation.cpuCascades & visibleCascades;
+      if (cpuNext != 0 && !cpuJob.valid()) {
+         // Only what the job steps stays current enough to hold.
+         cpuHeldCascades &= cpuNext;
+         float since = cpuJobTime < 0 ? dt : float(simTime + dt - cpuJobTime);
+         cpuJobTime = simTime + dt;
+         // With phasor evolution the waves are where the cascade's
+         // phasors get to on the next step, as submitSimulation counts
+         // its ticks.
+         uint32_t nextTicks = std::min(
+             static_cast<uint32_t>((phasorTime + dt) / phasorTick),
+             phasorMaxTicks);
+         std::vector<double> times(cascades, simTime + dt);
+         for (uint32_t i = 0; simulation.phasorEvolution && i < cascades;
+              ++i) {
+            times[i] = simulation.resetPhase
+                           ? 0.
+                           : double(schedules[i].phasorTicks + nextTicks) *
+                                 phasorTick;
+         }
+         startCpuJob(times, since, cpuNext);
+      }
+   };
+
+   // Fixed rate simulation clock. simAccumulator is the scaled time
+   // not simulated yet, frames blend the step at shownTick and the one
+   // before by it.
+   uint64_t simTick = 0;
+   uint64_t shownTick = 1;
+   double simTime = 0;
+   float simAccumulator = 0;
+   auto stepSimulation = [&](float tickTime) {
+      size_t slot = simTick % simHistory;
+      if (slotState[slot] != SlotState::Free &&
+          slotState[slot] != SlotState::Released) {
+         return false;
+      }
+      submitSimulation(simTick, simTime, tickTime);
+      simTime += tickTime;
+      ++simTick;
+      return true;
+   };
+
+   // Prime two steps so the first frame has both states to blend.
+   stepSimulation(1.f / simulation.tickRate);
+   stepSimulation(1.f / simulation.tickRate);
+   vkWaitForFences(lveDevice.device(), 1, &computeFences[shownTick], true,
+                   uint64_t(-1));
+
+   // Each spectrum set caches the spectrum of one key, so switching
+   // back to a recent state only rebinds the steps to its set. Edits to
+   // a state no set holds rebuild the least recently used set other
+   // than the front one on the compute queue while the steps go on
+   // reading the front one, which is switched once the rebuild's fence
+   // signals. Only one runs at a time, and none sooner than
+   // spectrumInitInterval after the last: edits made meanwhile are
+   // coalesced into the next one. With blendSpectra the switch is a
+   // transition over blendSeconds instead: the set left is baked into
+   // H0Blend, wherever the last transition was, and spectrumBlend goes
+   // from 0 to 1. A set being baked is not rebuilt.
+   constexpr float spectrumInitInterval = 0.1f;
+   VkCommandBuffer spectrumInitCommands;
+   VkFence spectrumInitFence;
+   {
+      VkCommandBufferAllocateInfo allocInfo = {};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.commandPool = lveDevice.getComputeCommandPool();
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocInfo.commandBufferCount = 1;
+      if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo,
+                                   &spectrumInitCommands) != VK_SUCCESS ||
+          vkCreateFence(lveDevice.device(), &FenceCreateInfo, nullptr,
+                        &spectrumInitFence) != VK_SUCCESS) {
+         throw std::runtime_error(
+             "failed to create spectrum init resources!");
+      }
+   }
+   // What a set holds. cascades keeps the compact output scales fitted
+   // to it, restored along with the set.
+   typedef struct {
+      uint64_t key;
+      uint64_t lastUsed;
+      std::vector<comp_ubo> cascades;
+   } spectrum_entry;
+   std::vector<spectrum_entry> spectrumEntries(spectrumSets);
+   uint64_t spectrumUses = 0;
+   spectrumEntries[frontSpectrum] = {spectrumKey(), spectrumUses, comp_buf};
+   bool spectrumInitPending = false;
+   size_t buildingSpectrum = 0;
+   uint64_t buildingKey = 0;
+   // Edits spec_params and wantedKey are up to date with.
+   uint64_t spectrumVersion = spec_conf.version;
+   uint64_t wantedKey = spectrumEntries[frontSpectrum].key;
+   float sinceSpectrumInit = spectrumInitInterval;
+   auto useSpectrum = [&](size_t set) {
+      frontSpectrum = set;
+      spectrumEntries[set].lastUsed = ++spectrumUses;
+      for (size_t g = 0; g < groups.size(); ++g) {
+         imgs[g][1] = groups[g].WavesData[set].get();
+         imgs[g][2] = groups[g].H0[set].get();
+      }
+   };
+   auto updateSpectrum = [&](float frameTime) {
+      sinceSpectrumInit += frameTime;
+      if (spectrumBlend < 1.f && !simulation.paused) {
+         spectrumBlend = std::min(
+             spectrumBlend + frameTime / simulation.blendSeconds, 1.f);
+         if (spectrumBlend == 1.f && compact) {
+            comp_buf = spectrumEntries[frontSpectrum].cascades;
+         }
+      }
+      simulation.spectrumBlend = spectrumBlend;
+      if (spectrumVersion != spec_conf.version) {
+         spectrumVersion = spec_conf.version;
+         updateSpectrumParameters();
+         wantedKey = spectrumKey();
+      }
+      if (spectrumInitPending &&
+          vkGetFenceStatus(lveDevice.device(), spectrumInitFence) ==
+              VK_SUCCESS) {
+         spectrumInitPending = false;
+         spectrum_entry &built = spectrumEntries[buildingSpectrum];
+         built.key = buildingKey;
+         if (compact) {
+            // The built set's scales only reach the steps once it is
+            // used.
+            std::vector<comp_ubo> shown = comp_buf;
+            fitOutputRanges();
+            built.cascades = comp_buf;
+            comp_buf = shown;
+         }
+      }
+      if (spectrumEntries[frontSpectrum].key == wantedKey) return;
+
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         if (spectrumEntries[set].key != wantedKey) continue;
+         const std::vector<comp_ubo> &scales = spectrumEntries[set].cascades;
+         if (simulation.blendSpectra) {
+            // The last bake still reads the set it left.
+            if (bakePending) return;
+            bakeSpectrum = frontSpectrum;
+            bakeWeight = spectrumBlend;
+            bakePending = true;
+            spectrumBlend = 0.f;
+            // A blend of two spectra stays within the larger range.
+            for (size_t i = 0; compact && i < cascades; ++i) {
+               comp_buf[i].DisplacementScale = glm::max(
+                   comp_buf[i].DisplacementScale, scales[i].DisplacementScale);
+               comp_buf[i].DisplacementBias = glm::min(
+                   comp_buf[i].DisplacementBias, scales[i].DisplacementBias);
+               comp_buf[i].DerivativesScale = glm::max(
+                   comp_buf[i].DerivativesScale, scales[i].DerivativesScale);
+            }
+         } else {
+            spectrumBlend = 1.f;
+            if (compact) comp_buf = scales;
+         }
+         useSpectrum(set);
+         // spec_params builds the set, the CPU switches at once.
+         if (cpuOcean) {
+            std::memcpy(cpuSpectrum, spec_params, sizeof(cpuSpectrum));
+            cpuSpectrumPending = true;
+         }
+         return;
+      }
+      if (spectrumInitPending || bakePending ||
+          sinceSpectrumInit < spectrumInitInterval) {
+         return;
+      }
+      sinceSpectrumInit = 0;
+
+      buildingSpectrum = frontSpectrum == 0 ? 1 : 0;
+      for (size_t set = 0; set < spectrumSets; ++set) {
+         if (set != frontSpectrum &&
+             spectrumEntries[set].lastUsed <
+                 spectrumEntries[buildingSpectrum].lastUsed) {
+            buildingSpectrum = set;
+         }
+      }
+      buildingKey = wantedKey;
+      spectrumEntries[buildingSpectrum].key = 0;
+      specBuf->writeToBuffer(spec_params);
+      specBuf->flush();
+
+      VkCommandBufferBeginInfo beginInfo = {};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      vkBeginCommandBuffer(spectrumInitCommands, &beginInfo);
+      recordSpectrumInit(spectrumInitCommands, buildingSpectrum);
+      lveDevice.endCommandBuffer(spectrumInitCommands);
+
+      VkSubmitInfo submitInfo = {};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &spectrumInitCommands;
+      vkResetFences(lveDevice.device(), 1, &spectrumInitFence);
+      if (vkQueueSubmit(lveDevice.computeQueue(), 1, &submitInfo,
+                        spectrumInitFence) != VK_SUCCESS) {
+         throw std::runtime_error("failed to submit spectrum init!");
+      }
+      spectrumInitPending = true;
+   };
+
+   // compareCpu: steps a CpuOcean of its own to the time of a snapshot
+   // with computed cascades, averages its displacement over the same
+   // blocks as readback.comp and measures the snapshot's error against
+   // it, on another thread. One comparison runs at a time, snapshots
+   // published meanwhile are skipped.
+   std::unique_ptr<CpuOcean> cpuReference;
+   uint64_t referenceKey = 0;
+   std::future<std::vector<glm::vec2>> compareJob;
+   auto compareWithCpu = [&]() {
+      if (compareJob.valid()) {
+         if (compareJob.wait_for(std::chrono::seconds(0)) !=
+             std::future_status::ready) {
+            return;
+         }
+         std::vector<glm::vec2> errors = compareJob.get();
+         for (uint32_t i = 0; i < cascades; ++i) {
+            if (errors[i].x < 0) continue;
+            simulation.cpuRms[i] = errors[i].x;
+            simulation.cpuMaxError[i] = errors[i].y;
+         }
+      }
+      OceanReadback::Handle snapshot = readback.latest();
+      if (compareCascades == 0 || !snapshot ||
+          snapshot->tick != compareTick ||
+          spectrumEntries[frontSpectrum].key != wantedKey) {
+         return;
+      }
+      uint32_t mask = compareCascades;
+      compareCascades = 0;
+      if (!cpuReference) {
+         // The comparison is a diagnostic and may run next to the hybrid
+         // CPU cascades' pool, the job's thread and one worker do.
+         cpuReference = std::make_unique<CpuOcean>(cpuSettings, 0, 2);
+      }
+      CpuOcean *ocean = cpuReference.get();
+      bool init = referenceKey != wantedKey;
+      referenceKey = wantedKey;
+      CpuSpectrumParameters spectrum[2];
+      std::memcpy(spectrum, spec_params, sizeof(spectrum));
+      float lambda = lamda_buf.lambda;
+      compareJob = std::async(
+          std::launch::async, [=, snapshot = std::move(snapshot)]() {
+             if (init) ocean->initSpectrum(spectrum);
+             ocean->step(
+                 std::vector<double>(ocean->cascadeCount(), snapshot->time),
+                 0.f, lambda, mask);
+             std::vector<glm::vec2> errors(ocean->cascadeCount(),
+                                           glm::vec2(-1.f));
+             for (uint32_t i = 0; i < errors.size(); ++i) {
+                if ((mask & (1u << i)) == 0) continue;
+                const std::vector<glm::vec4> &cpu = ocean->displacement(i);
+                const OceanSnapshot::Cascade &gpu = snapshot->data[i];
+                uint32_t n = uint32_t(std::sqrt(double(cpu.size())));
+                uint32_t stride = n / gpu.size;
+                float squared = 0, maxError = 0;
+                for (uint32_t y = 0; y < gpu.size; ++y) {
+                   for (uint32_t x = 0; x < gpu.size; ++x) {
+                      glm::vec3 sum(0.f);
+                      for (uint32_t v = 0; v < stride; ++v) {
+                         const glm::vec4 *row =
+                             &cpu[size_t(y * stride + v) * n + x * stride];
+                         for (uint32_t u = 0; u < stride; ++u) {
+                            sum += glm::vec3(row[u]);
+                         }
+                      }
+                      float error = glm::length(
+                          glm::vec3(gpu.texels[y * gpu.size + x]) -
+                          sum / float(stride * stride));
+                      squared += error * error;
+                      maxError = std::max(maxError, error);
+                   }
+                }
+                errors[i] = {std::sqrt(squared / (gpu.size * gpu.size)),
+                             maxError};
+             }
+             return errors;
+          });
+   };
+
    while (!lveWindow.shouldClose()) {
       glfwPollEvents();
 
@@ -1082,18 +2861,86 @@ void SecondApp::run() {
               .count();
       currentTime = newTime;
 
+      updateSpectrum(frameTime);
+      if (readbackPass) {
+         collectReadbacks(simTick);
+         compareWithCpu();
+      }
+
+      OceanReadback::Handle ocean = readback.latest();
       cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), frameTime,
-                                     viewerObject, navegando, xn, yn);
+                                     viewerObject, navegando, xn, yn,
+                                     ocean.get());
 
       camera.setViewYXZ(viewerObject.transform.translation,
                         viewerObject.transform.rotation);
 
       float aspect = lveRenderer.getAspectRatio();
-      camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f,
+      float fovy = glm::radians(50.f);
+      camera.setPerspectiveProjection(fovy, aspect, 0.1f,
                                       fmax(xn, yn) * 1.8);
 
+      // A cascade is simulated and drawn while its longest waves span at
+      // least minCascadePixels on screen at the closest water, straight
+      // below the camera. Turning it back on takes 25% more, so it does
+      // not flicker at the limit.
+      visibleCascades = (cascades < 32 ? 1u << cascades : 0u) - 1;
+      if (simulation.adaptiveCascades) {
+         float height =
+             std::max(-viewerObject.transform.translation.y, 0.1f);
+         float pixel = height * 2.f * std::tan(fovy / 2.f) /
+                       std::max(lveWindow.getExtent().height, 1u);
+         for (uint32_t i = 0; i < cascades; ++i) {
+            float longest =
+                std::min(comp_buf[i].LengthScale,
+                         2 * glm::pi<float>() / comp_buf[i].CutoffLow);
+            float limit = simulation.minCascadePixels;
+            if ((simulation.activeCascades & (1u << i)) == 0) {
+               limit *= 1.25f;
+            }
+            if (longest / pixel < limit) visibleCascades &= ~(1u << i);
+         }
+      }
+      simulation.activeCascades = visibleCascades;
+
+      float tickTime = 1.f / simulation.tickRate;
+      if (!simulation.paused) {
+         simAccumulator += frameTime * simulation.timeScale;
+      }
+      size_t steps = 0;
+      cascadeUpdates = 0;
+      for (; simAccumulator >= tickTime && steps < simHistory - 2;
+           ++steps) {
+         if (!stepSimulation(tickTime)) break;
+         simAccumulator -= tickTime;
+      }
+      // What could not be simulated this frame is dropped, not caught up.
+      simAccumulator = std::min(simAccumulator, tickTime);
+      simulation.fftPerFrame =
+          glm::mix(simulation.fftPerFrame, float(cascadeUpdates), 0.05f);
+      simulation.fftPerFrameFull = glm::mix(
+          simulation.fftPerFrameFull, float(steps * cascades), 0.05f);
+
       if (auto commandBuffer = lveRenderer.beginFrame()) {
          int frameIndex = lveRenderer.getFrameIndex();
+         // Show the newest step whose fence has signaled, the graphics
+         // queue never waits on one still running. The steps submitted
+         // this frame usually show from the next one on.
+         while (shownTick + 1 < simTick &&
+                vkGetFenceStatus(
+                    lveDevice.device(),
+                    computeFences[(shownTick + 1) % simHistory]) ==
+                    VK_SUCCESS) {
+            ++shownTick;
+         }
+         size_t latest = shownTick % simHistory;
+         size_t prev = (shownTick - 1) % simHistory;
+         waterRenderSystem.setDisplacementDescriptor(
+             disp_desc_set[latest]);
+         for (size_t g = 0; g < groups.size(); ++g) {
+            imgs[g][3] = groups[g].Displacement_Turbulence[latest].get();
+            imgs[g][4] = groups[g].Derivatives[latest].get();
+         }
          FrameInfo frameInfo{frameIndex,
                              frameTime,
                              commandBuffer,
@@ -1105,7 +2952,7 @@ void SecondApp::run() {
          // update
          myimgui.update(cameraController, navegando, pipeline,
                         viewerObject.transform.translation, frameTime,
-                        imgs, new_conf, angle, colors);
+                        imgs, spec_conf, angle, colors, simulation);
 
          time += frameTime;
          GlobalUbo ubo{};
@@ -1127,10 +2974,50 @@ void SecondApp::run() {
          ubo.bubbleColor.g = colors[2][1];
          ubo.bubbleColor.b = colors[2][2];
          ubo.navegando = navegando;
+         ubo.simBlend = simAccumulator / tickTime;
+         // Only what both blended steps simulated.
+         ubo.cascades = slotCascades[latest] & slotCascades[prev];
 
          uboBuffers[frameIndex]->writeToBuffer(&ubo);
          uboBuffers[frameIndex]->flush();
 
+         std::vector<VkSemaphore> finished;
+         std::vector<VkPipelineStageFlags> finishedStages;
+         std::vector<VkSemaphore> released;
+         // The vertex, evaluation and fragment shaders all sample the
+         // outputs, as does the GUI's preview of them.
+         constexpr VkPipelineStageFlags sampledStages =
+             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+             VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT |
+             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+         for (size_t slot = 0; slot < simHistory; ++slot) {
+            bool sampled = slot == latest || slot == prev;
+            // Slots hold the last simHistory ticks, those up to
+            // shownTick have finished.
+            uint64_t back = (simTick - 1 + simHistory - slot) % simHistory;
+            bool done = simTick - 1 - back <= shownTick;
+            if (slotState[slot] == SlotState::Computing && done) {
+               finished.push_back(computeFinished[slot]);
+               finishedStages.push_back(sampledStages);
+               for (cascade_group &group : groups) {
+                  for (MyTextureData *output :
+                       {group.Displacement_Turbulence[slot].get(),
+                        group.Derivatives[slot].get()}) {
+                     lveDevice.acquireImageOwnership(
+                         commandBuffer, output->Image,
+                         group.cascades.size(), families.computeFamily,
+                         families.graphicsFamily, sampledStages,
+                         VK_ACCESS_SHADER_READ_BIT);
+                  }
+               }
+               slotState[slot] = SlotState::Rendering;
+            } else if (slotState[slot] == SlotState::Rendering &&
+                       !sampled) {
+               released.push_back(outputReleased[slot]);
+               slotState[slot] = SlotState::Released;
+            }
+         }
+
          // render system
          lveRenderer.beginSwapChainRenderPass(commandBuffer);
 
@@ -1142,81 +3029,22 @@ void SecondApp::run() {
          myimgui.render(commandBuffer);
 
          lveRenderer.endSwapChainRenderPass(commandBuffer);
-         lveRenderer.endFrame();
-
-         lamda_buf.time = ubo.time;
-         lamda_buf.delta_time = frameTime;
-         lambdaBuffer->writeToBuffer(&lamda_buf);
-         lambdaBuffer->flush();
-
-         VkSubmitInfo submitInfo = {};
-         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-         submitInfo.commandBufferCount = 1;
-         submitInfo.pCommandBuffers = &computeCommandBuffer;
-         vkResetFences(lveDevice.device(), 1, &Fence);
-         vkQueueSubmit(lveDevice.computeQueue(), 1, &submitInfo, Fence);
-         vkWaitForFences(lveDevice.device(), 1, &Fence, true,
-                         uint64_t(-1));
-
-         if (new_conf[0].scale != spec_conf[0].scale ||
-             new_conf[0].windSpeed != spec_conf[0].windSpeed ||
-             new_conf[0].windDirection != spec_conf[0].windDirection ||
-             new_conf[0].fetch != spec_conf[0].fetch ||
-             new_conf[0].spreadBlend != spec_conf[0].spreadBlend ||
-             new_conf[0].swell != spec_conf[0].swell ||
-             new_conf[0].peakEnhancement != spec_conf[0].peakEnhancement ||
-             new_conf[0].shortWavesFade != spec_conf[0].shortWavesFade ||
-             new_conf[1].scale != spec_conf[1].scale ||
-             new_conf[1].windSpeed != spec_conf[1].windSpeed ||
-             new_conf[1].windDirection != spec_conf[1].windDirection ||
-             new_conf[1].fetch != spec_conf[1].fetch ||
-             new_conf[1].spreadBlend != spec_conf[1].spreadBlend ||
-             new_conf[1].swell != spec_conf[1].swell ||
-             new_conf[1].peakEnhancement != spec_conf[1].peakEnhancement ||
-             new_conf[1].shortWavesFade != spec_conf[1].shortWavesFade) {
-            spec_conf[0] = new_conf[0];
-            spec_conf[1] = new_conf[1];
-            spec_params[0].scale = spec_conf[0].scale;
-            spec_params[0].angle = spec_conf[0].windDirection;
-            spec_params[0].spreadBlend = spec_conf[0].spreadBlend;
-            spec_params[0].swell = spec_conf[0].swell;
-            spec_params[0].alpha =
-                jonswap_alpha(comp_buf[0].GravityAcceleration,
-                              spec_conf[0].fetch, spec_conf[0].windSpeed);
-            spec_params[0].peakOmega = jonswap_peak_features(
-                comp_buf[0].GravityAcceleration, spec_conf[0].fetch,
-                spec_conf[0].windSpeed);
-            spec_params[0].gamma = spec_conf[0].peakEnhancement;
-            spec_params[0].shortWavesFade = spec_conf[0].shortWavesFade;
-
-            spec_params[1].scale = spec_conf[1].scale;
-            spec_params[1].angle = spec_conf[1].windDirection;
-            spec_params[1].spreadBlend = spec_conf[1].spreadBlend;
-            spec_params[1].swell = spec_conf[1].swell;
-            spec_params[1].alpha =
-                jonswap_alpha(comp_buf[0].GravityAcceleration,
-                              spec_conf[1].fetch, spec_conf[1].windSpeed);
-            spec_params[1].peakOmega = jonswap_peak_features(
-                comp_buf[0].GravityAcceleration, spec_conf[1].fetch,
-                spec_conf[1].windSpeed);
-            spec_params[1].gamma = spec_conf[1].peakEnhancement;
-            spec_params[1].shortWavesFade = spec_conf[1].shortWavesFade;
-            specBuf->writeToBuffer(spec_params);
-            specBuf->flush();
-            init_spec.instant_dispatch(N, N, 1, init_spec_desc_set0);
-            conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set0);
-            init_spec.instant_dispatch(N, N, 1, init_spec_desc_set1);
-            conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set1);
-            init_spec.instant_dispatch(N, N, 1, init_spec_desc_set2);
-            conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set2);
-            init_spec.instant_dispatch(N, N, 1, init_spec_desc_set3);
-            conj_spec.instant_dispatch(N, N, 1, conj_spec_desc_set3);
-         }
+         lveRenderer.endFrame(finished, finishedStages, released);
       }
    }
 
-   vkDestroyFence(lveDevice.device(), Fence, nullptr);
    vkDeviceWaitIdle(lveDevice.device());
+   if (stepQueries != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(lveDevice.device(), stepQueries, nullptr);
+   }
+   for (size_t slot = 0; slot < simHistory; ++slot) {
+      vkDestroySemaphore(lveDevice.device(), computeFinished[slot],
+                         nullptr);
+      vkDestroySemaphore(lveDevice.device(), outputReleased[slot],
+                         nullptr);
+      vkDestroyFence(lveDevice.device(), computeFences[slot], nullptr);
+   }
+   vkDestroyFence(lveDevice.device(), spectrumInitFence, nullptr);
 }
 
 void SecondApp::loadGameObjects() {
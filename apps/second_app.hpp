@@ -3,7 +3,9 @@
 #include <vulkan/vulkan_core.h>
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "../lve/lve_descriptors.hpp"
 #include "../lve/lve_device.hpp"
@@ -11,14 +13,47 @@
 #include "../lve/lve_renderer.hpp"
 #include "../lve/lve_water.hpp"
 #include "../lve/lve_window.hpp"
+#include "../systems/ocean_readback.hpp"
 namespace lve {
 
+// Storage precision of the simulation's intermediate textures, see
+// shaders/precision.glsl. Half keeps everything fp16, Mixed makes the
+// FFT scratch fp32 and Full the initial spectrum too.
+enum class SimulationPrecision { Half, Mixed, Full };
+
+// Fields the simulation writes besides the displacement, as a mask
+// passed to the compute shaders as a specialization constant. Without
+// derivatives their FFT is skipped and the water shaders see flat
+// slopes. Turbulence needs the derivatives, and nothing draws the foam
+// it feeds yet.
+enum SimulationOutput : uint32_t {
+   OutputDerivatives = 1,
+   OutputTurbulence = 2,
+};
+
 class SecondApp {
   public:
    static constexpr int WIDTH = 800;
    static constexpr int HEIGHT = 600;
 
-   SecondApp(size_t);
+   // One ocean cascade is simulated per length scale, largest first.
+   // cascadeSizes holds the resolution of each cascade, when empty each
+   // one takes what its spectrum needs up to N, rounded up to at most
+   // four different sizes.
+   // compactOutputs packs the textures the water shaders sample in 4
+   // bytes a texel instead of 8, when the device supports the formats.
+   // outputs is a mask of SimulationOutput. spectrumCacheMiB bounds the
+   // device memory of the initial spectra kept to switch back to. hybrid
+   // lets some cascades be simulated on the CPU, with fp16 outputs.
+   // readbackTexels bounds the texels per side each cascade's
+   // displacement is read back to the CPU at, 0 turns it off.
+   SecondApp(size_t, std::vector<float> lengthScales,
+             std::vector<size_t> cascadeSizes = {},
+             SimulationPrecision precision = SimulationPrecision::Half,
+             bool compactOutputs = false,
+             uint32_t outputs = OutputDerivatives,
+             size_t spectrumCacheMiB = 64, bool hybrid = false,
+             uint32_t readbackTexels = 64);
    ~SecondApp();
 
    SecondApp(const SecondApp &) = delete;
@@ -28,6 +63,12 @@ class SecondApp {
 
    void loadGameObjects();
 
+   // The latest displacement read back while run() goes on, one or two
+   // frames behind, from any thread.
+   const OceanReadback &oceanReadback() const {
+      return readback;
+   }
+
   private:
    LveWindow lveWindow{WIDTH, HEIGHT, "Hello Vulkan!"};
    LveDevice lveDevice{lveWindow};
@@ -46,10 +87,10 @@ class SecondApp {
            .build();
    std::unique_ptr<LveDescriptorPool> computePool =
        LveDescriptorPool::Builder(lveDevice)
-           .setMaxSets(300)
-           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 300)
+           .setMaxSets(672)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1632)
            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 300)
-           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 600)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1264)
            .build();
 
    std::unique_ptr<LveWater> water = nullptr;
@@ -58,6 +99,15 @@ class SecondApp {
    uint32_t yn = 0;
 
    size_t N;
+   std::vector<float> lengthScales;
+   std::vector<size_t> cascadeSizes;
+   SimulationPrecision precision;
+   bool compactOutputs;
+   uint32_t outputs;
+   size_t spectrumCacheMiB;
+   bool hybrid;
+   uint32_t readbackTexels;
+   OceanReadback readback;
 
    void fixViewer(LveGameObject &, float);
 };
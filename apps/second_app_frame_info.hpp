@@ -27,6 +27,10 @@ struct GlobalUbo {
    glm::uint cols{5};
    glm::float32 time{0};
 	glm::uint navegando{0};
+   // Blend factor between the two latest simulation steps.
+   glm::float32 simBlend{1};
+   // Bit set for each cascade the water shaders sample.
+   glm::uint cascades{0};
 };
 
 struct FrameInfo {
@@ -35,7 +35,7 @@ VkDeviceSize LveBuffer::getAlignment(VkDeviceSize instanceSize,
 LveBuffer::LveBuffer(LveDevice &device, VkDeviceSize instanceSize,
                      uint32_t instanceCount, VkBufferUsageFlags usageFlags,
                      VkMemoryPropertyFlags memoryPropertyFlags,
-                     VkDeviceSize minOffsetAlignment)
+                     VkDeviceSize minOffsetAlignment, bool concurrent)
     : lveDevice{device},
       instanceSize{instanceSize},
       instanceCount{instanceCount},
@@ -44,7 +44,7 @@ LveBuffer::LveBuffer(LveDevice &device, VkDeviceSize instanceSize,
    alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
    bufferSize = alignmentSize * instanceCount;
    device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer,
-                       memory);
+                       memory, concurrent);
 }
 
 LveBuffer::~LveBuffer() {
@@ -11,7 +11,7 @@ class LveBuffer {
    LveBuffer(LveDevice& device, VkDeviceSize instanceSize,
              uint32_t instanceCount, VkBufferUsageFlags usageFlags,
              VkMemoryPropertyFlags memoryPropertyFlags,
-             VkDeviceSize minOffsetAlignment = 1);
+             VkDeviceSize minOffsetAlignment = 1, bool concurrent = false);
    ~LveBuffer();
 
    LveBuffer(const LveBuffer&) = delete;
@@ -48,7 +48,7 @@ class LveBuffer {
       return instanceSize;
    }
    VkDeviceSize getAlignmentSize() const {
-      return instanceSize;
+      return alignmentSize;
    }
    VkBufferUsageFlags getUsageFlags() const {
       return usageFlags;
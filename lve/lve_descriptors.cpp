@@ -167,21 +167,21 @@ LveDescriptorWriter &LveDescriptorWriter::writeBuffer(
 }
 
 LveDescriptorWriter &LveDescriptorWriter::writeImage(
-    uint32_t binding, VkDescriptorImageInfo *imageInfo) {
+    uint32_t binding, VkDescriptorImageInfo *imageInfo, uint32_t count) {
    assert(setLayout.bindings.count(binding) == 1 &&
           "Layout does not contain specified binding");
 
    auto &bindingDescription = setLayout.bindings[binding];
 
-   assert(bindingDescription.descriptorCount == 1 &&
-          "Binding single descriptor info, but binding expects multiple");
+   assert(bindingDescription.descriptorCount == count &&
+          "Image info count does not match the binding's descriptors");
 
    VkWriteDescriptorSet write{};
    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
    write.descriptorType = bindingDescription.descriptorType;
    write.dstBinding = binding;
    write.pImageInfo = imageInfo;
-   write.descriptorCount = 1;
+   write.descriptorCount = count;
 
    writes.push_back(write);
    return *this;
@@ -101,8 +101,11 @@ class LveDescriptorWriter {
 
    LveDescriptorWriter &writeBuffer(uint32_t binding,
                                     VkDescriptorBufferInfo *bufferInfo);
+   // count is the descriptorCount of an array binding, imageInfo then
+   // points to one info per element.
    LveDescriptorWriter &writeImage(uint32_t binding,
-                                   VkDescriptorImageInfo *imageInfo);
+                                   VkDescriptorImageInfo *imageInfo,
+                                   uint32_t count = 1);
 
    bool build(VkDescriptorSet &set);
    void overwrite(VkDescriptorSet &set);
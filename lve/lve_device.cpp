@@ -54,10 +54,20 @@ LveDevice::LveDevice(LveWindow &window) : window{window} {
    pickPhysicalDevice();
    createLogicalDevice();
    createCommandPool();
+
+   QueueFamilyIndices indices = findPhysicalQueueFamilies();
+   std::cout << "queue families: graphics " << indices.graphicsFamily
+             << ", present " << indices.presentFamily << ", compute "
+             << indices.computeFamily
+             << (indices.hasDedicatedCompute()
+                     ? " (dedicated async compute)"
+                     : " (shared with graphics)")
+             << std::endl;
 }
 
 LveDevice::~LveDevice() {
    vkDestroyCommandPool(device_, commandPool, nullptr);
+   vkDestroyCommandPool(device_, computeCommandPool, nullptr);
    vkDestroyDevice(device_, nullptr);
 
    if (enableValidationLayers) {
@@ -80,7 +90,7 @@ void LveDevice::createInstance() {
    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
    appInfo.pEngineName = "No Engine";
    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-   appInfo.apiVersion = VK_API_VERSION_1_0;
+   appInfo.apiVersion = VK_API_VERSION_1_1;
 
    VkInstanceCreateInfo createInfo = {};
    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -135,14 +145,29 @@ void LveDevice::pickPhysicalDevice() {
 
    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
    std::cout << "physical device: " << properties.deviceName << std::endl;
+
+   if (properties.apiVersion >= VK_API_VERSION_1_1) {
+      subgroupProperties.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+      VkPhysicalDeviceProperties2 properties2 = {};
+      properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      properties2.pNext = &subgroupProperties;
+      vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+      std::cout << "subgroup size: " << subgroupProperties.subgroupSize
+                << std::endl;
+      hasMemoryBudget = hasDeviceExtension(
+          physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+   }
 }
 
 void LveDevice::createLogicalDevice() {
-   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+   queueFamilies_ = findQueueFamilies(physicalDevice);
+   const QueueFamilyIndices &indices = queueFamilies_;
 
    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily,
-                                             indices.presentFamily};
+                                             indices.presentFamily,
+                                             indices.computeFamily};
 
    float queuePriority = 1.0f;
    for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -158,6 +183,14 @@ void LveDevice::createLogicalDevice() {
    deviceFeatures.samplerAnisotropy = VK_TRUE;
    deviceFeatures.fillModeNonSolid = VK_TRUE;
    deviceFeatures.tessellationShader = VK_TRUE;
+   // The water shaders pick each cascade's sampler by its group.
+   deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+   VkPhysicalDeviceFeatures supportedFeatures;
+   vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+   storageImageExtendedFormats =
+       supportedFeatures.shaderStorageImageExtendedFormats;
+   deviceFeatures.shaderStorageImageExtendedFormats =
+       supportedFeatures.shaderStorageImageExtendedFormats;
 
    VkDeviceCreateInfo createInfo = {};
    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -166,10 +199,15 @@ void LveDevice::createLogicalDevice() {
        static_cast<uint32_t>(queueCreateInfos.size());
    createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+   std::vector<const char *> extensions = deviceExtensions;
+   if (hasMemoryBudget) {
+      extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+   }
+
    createInfo.pEnabledFeatures = &deviceFeatures;
    createInfo.enabledExtensionCount =
-       static_cast<uint32_t>(deviceExtensions.size());
-   createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+       static_cast<uint32_t>(extensions.size());
+   createInfo.ppEnabledExtensionNames = extensions.data();
 
    // might not really be necessary anymore because device specific
    // validation layers have been deprecated
@@ -204,6 +242,12 @@ void LveDevice::createCommandPool() {
        VK_SUCCESS) {
       throw std::runtime_error("failed to create command pool!");
    }
+
+   poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily;
+   if (vkCreateCommandPool(device_, &poolInfo, nullptr,
+                           &computeCommandPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create compute command pool!");
+   }
 }
 
 void LveDevice::createSurface() {
@@ -227,7 +271,8 @@ bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
    vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
    return indices.isComplete() && extensionsSupported &&
-          swapChainAdequate && supportedFeatures.samplerAnisotropy;
+          swapChainAdequate && supportedFeatures.samplerAnisotropy &&
+          supportedFeatures.shaderSampledImageArrayDynamicIndexing;
 }
 
 void LveDevice::populateDebugMessengerCreateInfo(
@@ -340,6 +385,22 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
    return requiredExtensions.empty();
 }
 
+bool LveDevice::hasDeviceExtension(VkPhysicalDevice device,
+                                   const char *name) {
+   uint32_t extensionCount;
+   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                        nullptr);
+
+   std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                        availableExtensions.data());
+
+   for (const auto &extension : availableExtensions) {
+      if (strcmp(extension.extensionName, name) == 0) return true;
+   }
+   return false;
+}
+
 QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
    QueueFamilyIndices indices;
 
@@ -352,26 +413,35 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
                                             queueFamilies.data());
 
    int i = 0;
+   bool dedicatedCompute = false;
    for (const auto &queueFamily : queueFamilies) {
       if (queueFamily.queueCount > 0 &&
-          queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+          queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT &&
+          !indices.graphicsFamilyHasValue) {
          indices.graphicsFamily = i;
          indices.graphicsFamilyHasValue = true;
       }
       VkBool32 presentSupport = false;
       vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_,
                                            &presentSupport);
-      if (queueFamily.queueCount > 0 && presentSupport) {
+      if (queueFamily.queueCount > 0 && presentSupport &&
+          !indices.presentFamilyHasValue) {
          indices.presentFamily = i;
          indices.presentFamilyHasValue = true;
       }
+      // A compute family without graphics is preferred, it maps to
+      // hardware queues that can run next to rasterization.
+      bool computeOnly = !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
       if (queueFamily.queueCount > 0 &&
-          queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+          queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT &&
+          (!indices.computeFamilyHasValue ||
+           (computeOnly && !dedicatedCompute))) {
          indices.computeFamily = i;
          indices.computeFamilyHasValue = true;
+         dedicatedCompute = computeOnly;
       }
 
-      if (indices.isComplete()) {
+      if (indices.isComplete() && dedicatedCompute) {
          break;
       }
 
@@ -443,15 +513,59 @@ uint32_t LveDevice::findMemoryType(uint32_t typeFilter,
    throw std::runtime_error("failed to find suitable memory type!");
 }
 
+VkDeviceSize LveDevice::memoryBudget(VkMemoryPropertyFlags properties) {
+   VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+   budget.sType =
+       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+   VkPhysicalDeviceMemoryProperties2 memProperties2 = {};
+   memProperties2.sType =
+       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   if (hasMemoryBudget) {
+      memProperties2.pNext = &budget;
+      vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties2);
+   } else {
+      vkGetPhysicalDeviceMemoryProperties(
+          physicalDevice, &memProperties2.memoryProperties);
+   }
+   const VkPhysicalDeviceMemoryProperties &memProperties =
+       memProperties2.memoryProperties;
+
+   bool counted[VK_MAX_MEMORY_HEAPS] = {};
+   VkDeviceSize available = 0;
+   for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+      uint32_t heap = memProperties.memoryTypes[i].heapIndex;
+      if (counted[heap] ||
+          (memProperties.memoryTypes[i].propertyFlags & properties) !=
+              properties) {
+         continue;
+      }
+      counted[heap] = true;
+      if (!hasMemoryBudget) {
+         available += memProperties.memoryHeaps[heap].size;
+      } else if (budget.heapBudget[heap] > budget.heapUsage[heap]) {
+         available += budget.heapBudget[heap] - budget.heapUsage[heap];
+      }
+   }
+   return available;
+}
+
 void LveDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                              VkMemoryPropertyFlags properties,
                              VkBuffer &buffer,
-                             VkDeviceMemory &bufferMemory) {
+                             VkDeviceMemory &bufferMemory,
+                             bool concurrent) {
    VkBufferCreateInfo bufferInfo{};
    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
    bufferInfo.size = size;
    bufferInfo.usage = usage;
    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+   uint32_t queueFamilyIndices[] = {queueFamilies_.graphicsFamily,
+                                    queueFamilies_.computeFamily};
+   if (concurrent && hasDedicatedCompute()) {
+      bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      bufferInfo.queueFamilyIndexCount = 2;
+      bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+   }
 
    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) !=
        VK_SUCCESS) {
@@ -588,8 +702,78 @@ VkCommandBuffer LveDevice::beginCommandBuffer() {
    return commandBuffer;
 }
 
+VkCommandBuffer LveDevice::beginSingleTimeComputeCommands() {
+   VkCommandBuffer commandBuffer;
+   VkCommandBufferAllocateInfo allocInfo = {};
+   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+   allocInfo.commandPool = getComputeCommandPool();
+   allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+   allocInfo.commandBufferCount = 1;
+
+   vkAllocateCommandBuffers(device(), &allocInfo, &commandBuffer);
+
+   VkCommandBufferBeginInfo beginInfo = {};
+   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+   vkBeginCommandBuffer(commandBuffer, &beginInfo);
+   return commandBuffer;
+}
+
 void LveDevice::endCommandBuffer(VkCommandBuffer commandBuffer) {
    vkEndCommandBuffer(commandBuffer);
 }
 
+static VkImageMemoryBarrier ownershipBarrier(VkImage image,
+                                             uint32_t layerCount,
+                                             uint32_t srcFamily,
+                                             uint32_t dstFamily) {
+   VkImageMemoryBarrier barrier{};
+   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+   barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+   barrier.srcQueueFamilyIndex = srcFamily;
+   barrier.dstQueueFamilyIndex = dstFamily;
+   barrier.image = image;
+   barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+   barrier.subresourceRange.baseMipLevel = 0;
+   barrier.subresourceRange.levelCount = 1;
+   barrier.subresourceRange.baseArrayLayer = 0;
+   barrier.subresourceRange.layerCount = layerCount;
+   return barrier;
+}
+
+void LveDevice::releaseImageOwnership(VkCommandBuffer commandBuffer,
+                                      VkImage image, uint32_t layerCount,
+                                      uint32_t srcFamily,
+                                      uint32_t dstFamily,
+                                      VkPipelineStageFlags srcStage,
+                                      VkAccessFlags srcAccess) {
+   if (srcFamily == dstFamily) return;
+   VkImageMemoryBarrier barrier =
+       ownershipBarrier(image, layerCount, srcFamily, dstFamily);
+   barrier.srcAccessMask = srcAccess;
+   barrier.dstAccessMask = 0;
+   vkCmdPipelineBarrier(commandBuffer, srcStage,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                        nullptr, 0, nullptr, 1, &barrier);
+}
+
+void LveDevice::acquireImageOwnership(VkCommandBuffer commandBuffer,
+                                      VkImage image, uint32_t layerCount,
+                                      uint32_t srcFamily,
+                                      uint32_t dstFamily,
+                                      VkPipelineStageFlags dstStage,
+                                      VkAccessFlags dstAccess) {
+   if (srcFamily == dstFamily) return;
+   VkImageMemoryBarrier barrier =
+       ownershipBarrier(image, layerCount, srcFamily, dstFamily);
+   barrier.srcAccessMask = 0;
+   barrier.dstAccessMask = dstAccess;
+   // dstStage is also the source so the acquire chains with the
+   // semaphore wait that orders it after the release.
+   vkCmdPipelineBarrier(commandBuffer, dstStage, dstStage, 0, 0, nullptr,
+                        0, nullptr, 1, &barrier);
+}
+
 }  // namespace lve
@@ -24,6 +24,11 @@ struct QueueFamilyIndices {
       return graphicsFamilyHasValue && presentFamilyHasValue &&
              computeFamilyHasValue;
    }
+   // True when compute work runs on its own family (async compute) and
+   // images shared with graphics need ownership transfers.
+   bool hasDedicatedCompute() const {
+      return computeFamily != graphicsFamily;
+   }
 };
 
 class LveDevice {
@@ -46,6 +51,10 @@ class LveDevice {
    VkCommandPool getCommandPool() {
       return commandPool;
    }
+   // Command buffers submitted to computeQueue() come from this pool.
+   VkCommandPool getComputeCommandPool() {
+      return computeCommandPool;
+   }
    VkDevice device() {
       return device_;
    }
@@ -74,17 +83,28 @@ class LveDevice {
    }
    uint32_t findMemoryType(uint32_t typeFilter,
                            VkMemoryPropertyFlags properties);
+   // Bytes still available in the heaps backing memory types with the
+   // given properties. With VK_EXT_memory_budget this is the budget
+   // left to the process, otherwise the whole size of the heaps.
+   VkDeviceSize memoryBudget(VkMemoryPropertyFlags properties);
+   // Found once as the logical device is created.
    QueueFamilyIndices findPhysicalQueueFamilies() {
-      return findQueueFamilies(physicalDevice);
+      return queueFamilies_;
+   }
+   bool hasDedicatedCompute() const {
+      return queueFamilies_.hasDedicatedCompute();
    }
    VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates,
                                 VkImageTiling tiling,
                                 VkFormatFeatureFlags features);
 
    // Buffer Helper Functions
+   // concurrent shares the buffer between the graphics and compute
+   // families, for buffers both queues access. Without a dedicated
+   // compute family it changes nothing.
    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                      VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                     VkDeviceMemory &bufferMemory);
+                     VkDeviceMemory &bufferMemory, bool concurrent = false);
    VkCommandBuffer beginSingleTimeCommands();
    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
@@ -97,10 +117,36 @@ class LveDevice {
                             VkImage &image, VkDeviceMemory &imageMemory);
 
    VkPhysicalDeviceProperties properties;
+   // Subgroup size and operations, queried through Vulkan 1.1. Zeroed
+   // when the device only supports 1.0.
+   VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+   // VK_EXT_memory_budget is enabled when the device has it.
+   bool hasMemoryBudget = false;
+   // Storage images in the formats the shaders need
+   // shaderStorageImageExtendedFormats for, enabled when supported.
+   bool storageImageExtendedFormats = false;
 
    VkCommandBuffer beginCommandBuffer();
+   // Allocates from the compute pool, for work submitted to
+   // computeQueue().
+   VkCommandBuffer beginSingleTimeComputeCommands();
    void endCommandBuffer(VkCommandBuffer commandBuffer);
 
+   // Queue family ownership transfer of a whole image that stays in
+   // VK_IMAGE_LAYOUT_GENERAL. The release is recorded on the source
+   // family's queue and the matching acquire on the destination one,
+   // ordered by a semaphore. Both are no-ops when the families match.
+   void releaseImageOwnership(VkCommandBuffer commandBuffer, VkImage image,
+                              uint32_t layerCount, uint32_t srcFamily,
+                              uint32_t dstFamily,
+                              VkPipelineStageFlags srcStage,
+                              VkAccessFlags srcAccess);
+   void acquireImageOwnership(VkCommandBuffer commandBuffer, VkImage image,
+                              uint32_t layerCount, uint32_t srcFamily,
+                              uint32_t dstFamily,
+                              VkPipelineStageFlags dstStage,
+                              VkAccessFlags dstAccess);
+
   private:
    void createInstance();
    void setupDebugMessenger();
@@ -118,6 +164,7 @@ class LveDevice {
        VkDebugUtilsMessengerCreateInfoEXT &createInfo);
    void hasGflwRequiredInstanceExtensions();
    bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+   bool hasDeviceExtension(VkPhysicalDevice device, const char *name);
    SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
    VkInstance instance;
@@ -125,9 +172,11 @@ class LveDevice {
    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
    LveWindow &window;
    VkCommandPool commandPool;
+   VkCommandPool computeCommandPool;
 
    VkDevice device_;
    VkSurfaceKHR surface_;
+   QueueFamilyIndices queueFamilies_;
    VkQueue graphicsQueue_;
    VkQueue presentQueue_;
    VkQueue computeQueue_;
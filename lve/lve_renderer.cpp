@@ -103,7 +103,10 @@ VkCommandBuffer LveRenderer::beginFrame() {
    return commandBuffer;
 }
 
-void LveRenderer::endFrame() {
+void LveRenderer::endFrame(
+    const std::vector<VkSemaphore> &waitSemaphores,
+    const std::vector<VkPipelineStageFlags> &waitStages,
+    const std::vector<VkSemaphore> &signalSemaphores) {
    assert(isFrameStarted &&
           "Cannot call endFrame while frame is not in progress");
    auto commandBuffer = getCurrentCommandBuffert();
@@ -112,8 +115,9 @@ void LveRenderer::endFrame() {
       throw std::runtime_error("failed to record command buffer!");
    }
 
-   auto result = lveSwapChain->submitCommandBuffers(&commandBuffer,
-                                                    &currentImageIndex);
+   auto result = lveSwapChain->submitCommandBuffers(
+       &commandBuffer, &currentImageIndex, waitSemaphores, waitStages,
+       signalSemaphores);
    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
        lveWindow.wasWindowResized()) {
       lveWindow.resetWindowResizedFlag();
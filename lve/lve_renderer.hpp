@@ -47,7 +47,11 @@ class LveRenderer {
    }
 
    VkCommandBuffer beginFrame();
-   void endFrame();
+   // Extra semaphores are forwarded to the swap chain submit, letting
+   // other queues hand work over to the frame without host waits.
+   void endFrame(const std::vector<VkSemaphore> &waitSemaphores = {},
+                 const std::vector<VkPipelineStageFlags> &waitStages = {},
+                 const std::vector<VkSemaphore> &signalSemaphores = {});
    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
    void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
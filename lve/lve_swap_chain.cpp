@@ -79,8 +79,11 @@ VkResult LveSwapChain::acquireNextImage(uint32_t *imageIndex) {
    return result;
 }
 
-VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
-                                            uint32_t *imageIndex) {
+VkResult LveSwapChain::submitCommandBuffers(
+    const VkCommandBuffer *buffers, uint32_t *imageIndex,
+    const std::vector<VkSemaphore> &extraWaitSemaphores,
+    const std::vector<VkPipelineStageFlags> &extraWaitStages,
+    const std::vector<VkSemaphore> &extraSignalSemaphores) {
    if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
       vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex],
                       VK_TRUE, UINT64_MAX);
@@ -90,20 +93,28 @@ VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
    VkSubmitInfo submitInfo = {};
    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-   VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-   VkPipelineStageFlags waitStages[] = {
+   std::vector<VkSemaphore> waitSemaphores = {
+       imageAvailableSemaphores[currentFrame]};
+   std::vector<VkPipelineStageFlags> waitStages = {
        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-   submitInfo.waitSemaphoreCount = 1;
-   submitInfo.pWaitSemaphores = waitSemaphores;
-   submitInfo.pWaitDstStageMask = waitStages;
+   waitSemaphores.insert(waitSemaphores.end(), extraWaitSemaphores.begin(),
+                         extraWaitSemaphores.end());
+   waitStages.insert(waitStages.end(), extraWaitStages.begin(),
+                     extraWaitStages.end());
+   submitInfo.waitSemaphoreCount = waitSemaphores.size();
+   submitInfo.pWaitSemaphores = waitSemaphores.data();
+   submitInfo.pWaitDstStageMask = waitStages.data();
 
    submitInfo.commandBufferCount = 1;
    submitInfo.pCommandBuffers = buffers;
 
-   VkSemaphore signalSemaphores[] = {
+   std::vector<VkSemaphore> signalSemaphores = {
        renderFinishedSemaphores[currentFrame]};
-   submitInfo.signalSemaphoreCount = 1;
-   submitInfo.pSignalSemaphores = signalSemaphores;
+   signalSemaphores.insert(signalSemaphores.end(),
+                           extraSignalSemaphores.begin(),
+                           extraSignalSemaphores.end());
+   submitInfo.signalSemaphoreCount = signalSemaphores.size();
+   submitInfo.pSignalSemaphores = signalSemaphores.data();
 
    vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo,
@@ -115,7 +126,7 @@ VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
    presentInfo.waitSemaphoreCount = 1;
-   presentInfo.pWaitSemaphores = signalSemaphores;
+   presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
    VkSwapchainKHR swapChains[] = {swapChain};
    presentInfo.swapchainCount = 1;
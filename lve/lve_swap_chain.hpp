@@ -55,8 +55,13 @@ class LveSwapChain {
    VkFormat findDepthFormat();
 
    VkResult acquireNextImage(uint32_t *imageIndex);
-   VkResult submitCommandBuffers(const VkCommandBuffer *buffers,
-                                 uint32_t *imageIndex);
+   // The extra semaphores are waited on / signaled by the frame's submit
+   // on top of the swap chain's own ones.
+   VkResult submitCommandBuffers(
+       const VkCommandBuffer *buffers, uint32_t *imageIndex,
+       const std::vector<VkSemaphore> &extraWaitSemaphores = {},
+       const std::vector<VkPipelineStageFlags> &extraWaitStages = {},
+       const std::vector<VkSemaphore> &extraSignalSemaphores = {});
 
    bool compareSwapFormats(const LveSwapChain &swapChain) const {
       return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -1,17 +1,90 @@
+#include <algorithm>
 #include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "../apps/second_app.hpp"
 int main(int argc, char* argv[]) {
+	// --precision=fp16|mixed|fp32 picks the storage precision of the
+	// simulation, --outputs=fp16|compact the format of what the water
+	// shaders sample, --fields=height|slopes|foam which fields are
+	// simulated, --spectrum-cache=MiB how much device memory keeps
+	// earlier spectra around, --hybrid moves cascades to the CPU when
+	// the GPU is the bottleneck and --readback=texels|0 bounds the
+	// resolution the displacement is read back to the CPU at, the rest
+	// of the arguments are positional
+	lve::SimulationPrecision precision = lve::SimulationPrecision::Half;
+	bool compactOutputs = false;
+	uint32_t fields = lve::OutputDerivatives;
+	size_t spectrumCacheMiB = 64;
+	bool hybrid = false;
+	uint32_t readbackTexels = 64;
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg.rfind("--", 0) != 0) {
+			args.push_back(arg);
+		} else if (arg == "--precision=fp16") {
+			precision = lve::SimulationPrecision::Half;
+		} else if (arg == "--precision=mixed") {
+			precision = lve::SimulationPrecision::Mixed;
+		} else if (arg == "--precision=fp32") {
+			precision = lve::SimulationPrecision::Full;
+		} else if (arg == "--outputs=fp16") {
+			compactOutputs = false;
+		} else if (arg == "--outputs=compact") {
+			compactOutputs = true;
+		} else if (arg == "--fields=height") {
+			fields = 0;
+		} else if (arg == "--fields=slopes") {
+			fields = lve::OutputDerivatives;
+		} else if (arg == "--fields=foam") {
+			fields = lve::OutputDerivatives | lve::OutputTurbulence;
+		} else if (arg.rfind("--spectrum-cache=", 0) == 0) {
+			spectrumCacheMiB = std::stoul(arg.substr(17));
+		} else if (arg == "--hybrid") {
+			hybrid = true;
+		} else if (arg.rfind("--readback=", 0) == 0) {
+			readbackTexels = std::stoul(arg.substr(11));
+		} else {
+			std::cerr << "unknown option " << arg << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+	// Either one size for the mesh and the largest cascade, or a comma
+	// separated size per cascade
 	size_t N = 256;
-	if (argc > 1) {
-		N = std::stoi(argv[1]);
+	std::vector<size_t> cascadeSizes;
+	if (!args.empty()) {
+		std::string sizes = args[0];
+		if (sizes.find(',') == std::string::npos) {
+			N = std::stoi(sizes);
+		} else {
+			size_t start = 0;
+			while (start <= sizes.size()) {
+				size_t end = sizes.find(',', start);
+				if (end == std::string::npos) end = sizes.size();
+				cascadeSizes.push_back(
+						std::stoi(sizes.substr(start, end - start)));
+				start = end + 1;
+			}
+			N = *std::max_element(cascadeSizes.begin(), cascadeSizes.end());
+		}
+	}
+	// Any further arguments replace the default cascade length scales
+	std::vector<float> lengthScales;
+	for (size_t i = 1; i < args.size(); ++i) {
+		lengthScales.push_back(std::stof(args[i]));
+	}
+	if (lengthScales.empty()) {
+		lengthScales = {1279.f, 255.f, 17.f, 5.f};
 	}
-   lve::SecondApp app{N};
-
    try {
+      lve::SecondApp app{N, lengthScales, cascadeSizes, precision,
+                         compactOutputs, fields, spectrumCacheMiB, hybrid,
+                         readbackTexels};
       app.run();
    } catch (const std::exception& e) {
       std::cerr << e.what() << '\n';
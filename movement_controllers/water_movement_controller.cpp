@@ -14,7 +14,8 @@ namespace lve {
 void WaterMovementController::moveInPlaneXZ(GLFWwindow* window, float dt,
                                             LveGameObject& gameObject,
                                             bool navegando, uint32_t ext_x,
-                                            uint32_t ext_y) {
+                                            uint32_t ext_y,
+                                            const OceanSnapshot* ocean) {
    int state = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
    if (state == GLFW_PRESS && !changedMouse) {
       int cursor_mode =
@@ -85,13 +86,6 @@ void WaterMovementController::moveInPlaneXZ(GLFWwindow* window, float dt,
       uint32_t xn = ext_x * scale;
       uint32_t yn = ext_y * scale;
 
-      uint32_t x = glm::clamp(
-          xn - (uint32_t)roundf(gameObject.transform.translation.x),
-          (uint32_t)0, xn - 1);
-      uint32_t y =
-          glm::clamp((uint32_t)roundf(gameObject.transform.translation.z),
-                     (uint32_t)0, yn - 1);
-
       float roof = fmin(xn, yn);
       float floor = -roof;
 
@@ -109,28 +103,18 @@ void WaterMovementController::moveInPlaneXZ(GLFWwindow* window, float dt,
              moveSpeed * dt * glm::normalize(moveDir);
       }
 
-      uint32_t x0 = glm::clamp(
-          xn - (uint32_t)floorf(gameObject.transform.translation.x),
-          (uint32_t)0, xn - 1);
-      uint32_t y0 =
-          glm::clamp((uint32_t)floorf(gameObject.transform.translation.z),
-                     (uint32_t)0, yn - 1);
-
-      uint32_t x1 = glm::clamp(
-          xn - (uint32_t)ceilf(gameObject.transform.translation.x),
-          (uint32_t)0, xn - 1);
-      uint32_t y1 =
-          glm::clamp((uint32_t)ceilf(gameObject.transform.translation.z),
-                     (uint32_t)0, yn - 1);
-
-      float x_reg = glm::fract(gameObject.transform.translation.x);
-      float y_reg = glm::fract(gameObject.transform.translation.z);
-
       float cam_floor = -floor;
       float cam_roof = -roof;
       gameObject.transform.translation = glm::clamp(
           gameObject.transform.translation, glm::vec3{0.f, cam_roof, 0.f},
           glm::vec3{xn, cam_floor, yn});
+
+      // The surface is at the displacement's height, y points down.
+      if (ocean && !navegando) {
+         glm::vec3& position = gameObject.transform.translation;
+         float surface = ocean->height({position.x, position.z});
+         position.y = fmin(position.y, surface - waterClearance);
+      }
    }
 }
 
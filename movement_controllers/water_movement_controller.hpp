@@ -5,6 +5,7 @@
 #include <cstdint>
 
 #include "../lve/lve_game_object.hpp"
+#include "../systems/ocean_readback.hpp"
 
 namespace lve {
 
@@ -23,14 +24,18 @@ class WaterMovementController {
       int moveBackward2 = GLFW_KEY_DOWN;
    };
 
+   // ocean, when there is one, keeps the camera waterClearance above
+   // the water while flying.
    void moveInPlaneXZ(GLFWwindow* window, float dt,
                       LveGameObject& gameObject, bool navegando,
-                      uint32_t ext_x, uint32_t ext_y);
+                      uint32_t ext_x, uint32_t ext_y,
+                      const OceanSnapshot* ocean = nullptr);
 
    KeyMappings keys{};
    float moveSpeedMin{3.f};
    float moveSpeedMax{150.f};
    float lookSpeed{2.f};
+   float waterClearance{2.f};
    bool normalMouse{true};
    bool changedMouse{false};
    double lastX;
@@ -0,0 +1,39 @@
+// Storage formats of the simulation's intermediate textures. The
+// Makefile builds the shaders that include this once per precision
+// mode, PRECISION picks the formats second_app.cpp creates for it:
+//   0  everything fp16, the math is fp32 in registers either way.
+//   1  (mixed) the spectra the FFT runs in and its ping pong textures
+//      are fp32, the initial spectrum stays fp16.
+//   2  (full) the initial spectrum is fp32 too.
+// The outputs sampled by the water shaders are fp16 in every mode,
+// unless COMPACT_OUTPUTS is defined.
+
+#ifndef PRECISION
+#define PRECISION 0
+#endif
+
+#if PRECISION >= 1
+#define SCRATCH_FORMAT rgba32f
+#else
+#define SCRATCH_FORMAT rgba16f
+#endif
+
+#if PRECISION >= 2
+#define SPECTRUM_FORMAT rgba32f
+#define H0K_FORMAT rg32f
+#else
+#define SPECTRUM_FORMAT rgba16f
+#define H0K_FORMAT rg16f
+#endif
+
+// COMPACT_OUTPUTS packs the outputs in 4 bytes a texel, displacement in
+// unorm 10 bit channels and derivatives in snorm 8 bit ones. Either way
+// they hold (value - bias) / scale, with a scale and bias per cascade
+// and channel in CompUboIner.
+#ifdef COMPACT_OUTPUTS
+#define DISPLACEMENT_FORMAT rgb10_a2
+#define DERIVATIVES_FORMAT rgba8_snorm
+#else
+#define DISPLACEMENT_FORMAT rgba16f
+#define DERIVATIVES_FORMAT rgba16f
+#endif
@@ -18,6 +18,8 @@ layout(set = 0, binding = 0) uniform GloablUbo {
 	uint cols;
 	float time;
 	uint navegando;
+	float simBlend;
+	uint cascades;
 } ubo;
 
 struct CompUboIner
@@ -28,23 +30,54 @@ struct CompUboIner
 	float GravityAcceleration;
 	float Depth;
 	uint Size;
+	// Size group of the cascade and its layer in the group's textures.
+	uint Group;
+	uint Layer;
+	// The outputs hold (value - bias) / scale, per channel.
+	vec4 DisplacementScale;
+	vec4 DisplacementBias;
+	vec4 DerivativesScale;
+	vec4 DerivativesBias;
 };
 
+// One entry per cascade.
 layout(set = 1, binding = 0) buffer CompUbo {
-	CompUboIner data[4];
+	CompUboIner data[];
 } comp_ubo;
 
-layout(set = 1, binding = 1) uniform sampler2D Displacement_Turbulence0;
-layout(set = 1, binding = 2) uniform sampler2D Derivatives0;
-
-layout(set = 1, binding = 3) uniform sampler2D Displacement_Turbulence1;
-layout(set = 1, binding = 4) uniform sampler2D Derivatives1;
-
-layout(set = 1, binding = 5) uniform sampler2D Displacement_Turbulence2;
-layout(set = 1, binding = 6) uniform sampler2D Derivatives2;
+// Cascades of the same size share array textures, one layer each. The
+// array is indexed by the cascade's group, maxCascadeGroups in
+// second_app.cpp.
+const int CASCADE_GROUPS = 4;
+layout(set = 1, binding = 1) uniform sampler2DArray Displacement_Turbulence[CASCADE_GROUPS];
+layout(set = 1, binding = 2) uniform sampler2DArray Derivatives[CASCADE_GROUPS];
+layout(set = 1, binding = 3) uniform sampler2DArray PrevDisplacement_Turbulence[CASCADE_GROUPS];
+layout(set = 1, binding = 4) uniform sampler2DArray PrevDerivatives[CASCADE_GROUPS];
+// The cascades as the step before had them, its outputs are packed
+// with these scales.
+layout(set = 1, binding = 5) buffer PrevCompUbo {
+	CompUboIner data[];
+} prev_comp_ubo;
+
+// The simulation runs at a fixed rate, blend its two latest steps,
+// each unpacked with its own scales.
+vec4 sampleDisplacement(vec2 pos, int c) {
+	CompUboIner cascade = comp_ubo.data[c];
+	vec3 uv = vec3(pos / cascade.LengthScale, cascade.Layer);
+	CompUboIner prev = prev_comp_ubo.data[c];
+	vec4 latest = texture(Displacement_Turbulence[cascade.Group], uv) * cascade.DisplacementScale + cascade.DisplacementBias;
+	vec4 before = texture(PrevDisplacement_Turbulence[cascade.Group], uv) * prev.DisplacementScale + prev.DisplacementBias;
+	return mix(before, latest, ubo.simBlend);
+}
 
-layout(set = 1, binding = 7) uniform sampler2D Displacement_Turbulence3;
-layout(set = 1, binding = 8) uniform sampler2D Derivatives3;
+vec4 sampleDerivatives(vec2 pos, int c) {
+	CompUboIner cascade = comp_ubo.data[c];
+	vec3 uv = vec3(pos / cascade.LengthScale, cascade.Layer);
+	CompUboIner prev = prev_comp_ubo.data[c];
+	vec4 latest = texture(Derivatives[cascade.Group], uv) * cascade.DerivativesScale + cascade.DerivativesBias;
+	vec4 before = texture(PrevDerivatives[cascade.Group], uv) * prev.DerivativesScale + prev.DerivativesBias;
+	return mix(before, latest, ubo.simBlend);
+}
 
 float DotClamped (vec3 a, vec3 b) {
 	return max(0.0, dot(a, b));
@@ -78,11 +111,11 @@ void main() {
 
 	vec2 id = fragPosWorld.xz;
 
-	vec4 derivatives = 
-		   texture(Derivatives0, id / comp_ubo.data[0].LengthScale)
-		 + texture(Derivatives1, id / comp_ubo.data[1].LengthScale)
-		 + texture(Derivatives2, id / comp_ubo.data[2].LengthScale)
-		 + texture(Derivatives3, id / comp_ubo.data[3].LengthScale);
+	vec4 derivatives = vec4(0);
+	for (int c = 0; c < comp_ubo.data.length(); ++c) {
+		if ((ubo.cascades & (1u << c)) == 0) continue;
+		derivatives += sampleDerivatives(id, c);
+	}
 
 	vec2 slope = vec2(derivatives.x / (1 + derivatives.z),
                 derivatives.y / (1 + derivatives.w));
@@ -102,11 +135,11 @@ void main() {
 
 	float NdotL = DotClamped(mesoNormal, lightDir);
 
-	/*float turbulence = 
-		  texture(Displacement_Turbulence0, id / comp_ubo.data[0].LengthScale).a
-		+ texture(Displacement_Turbulence1, id / comp_ubo.data[1].LengthScale).a
-		+ texture(Displacement_Turbulence2, id / comp_ubo.data[2].LengthScale).a;
-		//+ texture(Displacement_Turbulence3, id / comp_ubo.data[3].LengthScale).a;
+	/*float turbulence = 0;
+	for (int c = 0; c < comp_ubo.data.length() - 1; ++c) {
+		if ((ubo.cascades & (1u << c)) == 0) continue;
+		turbulence += sampleDisplacement(id, c).a;
+	}
 
 	float foam = mix(0.0f, clamp(-turbulence, 0.0, 1.0), pow(depth, foam_depth_falloff));*/
 
@@ -16,6 +16,8 @@ layout(set = 0, binding = 0) uniform GloablUbo {
 	uint cols;
 	float time;
 	uint navegando;
+	float simBlend;
+	uint cascades;
 } ubo;
 
 struct CompUboIner
@@ -26,23 +28,72 @@ struct CompUboIner
 	float GravityAcceleration;
 	float Depth;
 	uint Size;
+	// Size group of the cascade and its layer in the group's textures.
+	uint Group;
+	uint Layer;
+	// The outputs hold (value - bias) / scale, per channel.
+	vec4 DisplacementScale;
+	vec4 DisplacementBias;
+	vec4 DerivativesScale;
+	vec4 DerivativesBias;
 };
 
+// One entry per cascade.
 layout(set = 1, binding = 0) buffer CompUbo {
-	CompUboIner data[4];
+	CompUboIner data[];
 } comp_ubo;
 
-layout(set = 1, binding = 1) uniform sampler2D Displacement_Turbulence0;
-layout(set = 1, binding = 2) uniform sampler2D Derivatives0;
+// Cascades of the same size share array textures, one layer each. The
+// array is indexed by the cascade's group, maxCascadeGroups in
+// second_app.cpp.
+const int CASCADE_GROUPS = 4;
+layout(set = 1, binding = 1) uniform sampler2DArray Displacement_Turbulence[CASCADE_GROUPS];
+layout(set = 1, binding = 2) uniform sampler2DArray Derivatives[CASCADE_GROUPS];
+layout(set = 1, binding = 3) uniform sampler2DArray PrevDisplacement_Turbulence[CASCADE_GROUPS];
+layout(set = 1, binding = 4) uniform sampler2DArray PrevDerivatives[CASCADE_GROUPS];
+// The cascades as the step before had them, its outputs are packed
+// with these scales.
+layout(set = 1, binding = 5) buffer PrevCompUbo {
+	CompUboIner data[];
+} prev_comp_ubo;
+
+// The simulation runs at a fixed rate, blend its two latest steps,
+// each unpacked with its own scales.
+vec4 sampleDisplacement(vec2 pos, int c) {
+	CompUboIner cascade = comp_ubo.data[c];
+	vec3 uv = vec3(pos / cascade.LengthScale, cascade.Layer);
+	CompUboIner prev = prev_comp_ubo.data[c];
+	vec4 latest = texture(Displacement_Turbulence[cascade.Group], uv) * cascade.DisplacementScale + cascade.DisplacementBias;
+	vec4 before = texture(PrevDisplacement_Turbulence[cascade.Group], uv) * prev.DisplacementScale + prev.DisplacementBias;
+	return mix(before, latest, ubo.simBlend);
+}
 
-layout(set = 1, binding = 3) uniform sampler2D Displacement_Turbulence1;
-layout(set = 1, binding = 4) uniform sampler2D Derivatives1;
+vec4 sampleDerivatives(vec2 pos, int c) {
+	CompUboIner cascade = comp_ubo.data[c];
+	vec3 uv = vec3(pos / cascade.LengthScale, cascade.Layer);
+	CompUboIner prev = prev_comp_ubo.data[c];
+	vec4 latest = texture(Derivatives[cascade.Group], uv) * cascade.DerivativesScale + cascade.DerivativesBias;
+	vec4 before = texture(PrevDerivatives[cascade.Group], uv) * prev.DerivativesScale + prev.DerivativesBias;
+	return mix(before, latest, ubo.simBlend);
+}
 
-layout(set = 1, binding = 5) uniform sampler2D Displacement_Turbulence2;
-layout(set = 1, binding = 6) uniform sampler2D Derivatives2;
+vec3 displacement(vec2 pos, int cascades) {
+	vec3 disp = vec3(0);
+	for (int c = 0; c < cascades; ++c) {
+		if ((ubo.cascades & (1u << c)) == 0) continue;
+		disp += sampleDisplacement(pos, c).xyz;
+	}
+	return disp;
+}
 
-layout(set = 1, binding = 7) uniform sampler2D Displacement_Turbulence3;
-layout(set = 1, binding = 8) uniform sampler2D Derivatives3;
+vec4 derivatives(vec2 pos, int cascades) {
+	vec4 derv = vec4(0);
+	for (int c = 0; c < cascades; ++c) {
+		if ((ubo.cascades & (1u << c)) == 0) continue;
+		derv += sampleDerivatives(pos, c);
+	}
+	return derv;
+}
 
 void main() {
 	uint plg = gl_VertexIndex / 3;
@@ -60,21 +111,18 @@ void main() {
 
 	vec2 id = vec2(x, z) * 5;
 
-	vec3 position = vec3(id.x, 0, id.y)
-		+ texture(Displacement_Turbulence0, id / comp_ubo.data[0].LengthScale).xyz
-		+ texture(Displacement_Turbulence1, id / comp_ubo.data[1].LengthScale).xyz
-		+ texture(Displacement_Turbulence2, id / comp_ubo.data[2].LengthScale).xyz
-		+ texture(Displacement_Turbulence3, id / comp_ubo.data[3].LengthScale).xyz;
+	int cascades = comp_ubo.data.length();
+	vec3 position = vec3(id.x, 0, id.y) + displacement(id, cascades);
    vec4 positionWorld = vec4(position, 1.0);
 
 	mat4 l_view = ubo.view;
 	vec3 cpos = ubo.invView[3].xyz;
 	if (ubo.navegando != 0){
-		vec4 derivatives = 
-				texture(Derivatives0, cpos.xz / comp_ubo.data[0].LengthScale)
-			 + texture(Derivatives1, cpos.xz / comp_ubo.data[1].LengthScale);
-		vec2 slope = vec2(derivatives.x / (1 + derivatives.z),
-						 derivatives.y / (1 + derivatives.w));
+		// The boat only follows the two largest cascades
+		int boat_cascades = min(cascades, 2);
+		vec4 derv = derivatives(cpos.xz, boat_cascades);
+		vec2 slope = vec2(derv.x / (1 + derv.z),
+						 derv.y / (1 + derv.w));
 
 		vec3 rigth = ubo.invView[0].xyz;
 		vec3 up = normalize(vec3(-slope.x, 1, -slope.y));
@@ -88,8 +136,7 @@ void main() {
 		up = cross(front, rigth);
 
 		cpos = vec3(cpos.x, -2, cpos.z)
-			+ texture(Displacement_Turbulence0, cpos.xz / comp_ubo.data[0].LengthScale).xyz
-			+ texture(Displacement_Turbulence1, cpos.xz / comp_ubo.data[1].LengthScale).xyz;
+			+ displacement(cpos.xz, boat_cascades);
 		l_view[0] = vec4(rigth.x, up.x, front.x, 0);
 		l_view[1] = vec4(rigth.y, up.y, front.y, 0);
 		l_view[2] = vec4(rigth.z, up.z, front.z, 0);
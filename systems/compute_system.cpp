@@ -3,21 +3,28 @@
 #include <vulkan/vulkan_core.h>
 
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 namespace lve {
 
+VkCommandBuffer ComputeSystem::bindedCmdBuffer;
 VkPipeline ComputeSystem::bindedPipeline;
 VkDescriptorSet ComputeSystem::bindedDescriptorSet;
 
 ComputeSystem::ComputeSystem(
     LveDevice &device,
     const std::vector<VkDescriptorSetLayout> desc_layout,
-    const std::string &compFilepath)
-    : lveDevice(device) {
+    const std::string &compFilepath,
+    const std::vector<uint32_t> &specialization,
+    uint32_t pushConstantSize)
+    : lveDevice(device),
+      specialization(specialization),
+      pushConstantSize(pushConstantSize) {
    createFence();
    createPipelineLayout(desc_layout);
    createShaderModule(compFilepath);
@@ -46,12 +53,23 @@ void ComputeSystem::createFence() {
 
 void ComputeSystem::createPipelineLayout(
     const std::vector<VkDescriptorSetLayout> desc_layout) {
+   if (pushConstantSize >
+       lveDevice.properties.limits.maxPushConstantsSize) {
+      throw std::runtime_error("push constants exceed the device limit");
+   }
+   VkPushConstantRange pushConstantRange = {};
+   pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+   pushConstantRange.offset = 0;
+   pushConstantRange.size = pushConstantSize;
+
    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
    pipelineLayoutCreateInfo.sType =
        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
    pipelineLayoutCreateInfo.pNext = nullptr;
-   pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-   pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+   pipelineLayoutCreateInfo.pushConstantRangeCount =
+       pushConstantSize ? 1 : 0;
+   pipelineLayoutCreateInfo.pPushConstantRanges =
+       pushConstantSize ? &pushConstantRange : nullptr;
    pipelineLayoutCreateInfo.setLayoutCount = desc_layout.size();
    pipelineLayoutCreateInfo.pSetLayouts = desc_layout.data();
 
@@ -65,6 +83,18 @@ void ComputeSystem::createPipelineLayout(
 void ComputeSystem::createPipeline() {
    assert(pipelineLayout != nullptr &&
           "Cannot create pipeline before pipeline layout");
+   std::vector<VkSpecializationMapEntry> mapEntries(specialization.size());
+   for (uint32_t i = 0; i < mapEntries.size(); ++i) {
+      mapEntries[i].constantID = i;
+      mapEntries[i].offset = i * sizeof(uint32_t);
+      mapEntries[i].size = sizeof(uint32_t);
+   }
+   VkSpecializationInfo specializationInfo = {};
+   specializationInfo.mapEntryCount = mapEntries.size();
+   specializationInfo.pMapEntries = mapEntries.data();
+   specializationInfo.dataSize = specialization.size() * sizeof(uint32_t);
+   specializationInfo.pData = specialization.data();
+
    VkPipelineShaderStageCreateInfo stageInfo = {};
    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
    stageInfo.pNext = nullptr;
@@ -72,7 +102,8 @@ void ComputeSystem::createPipeline() {
    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
    stageInfo.module = module;
    stageInfo.pName = "main";
-   stageInfo.pSpecializationInfo = nullptr;
+   stageInfo.pSpecializationInfo =
+       specialization.empty() ? nullptr : &specializationInfo;
 
    VkComputePipelineCreateInfo pipelineCreateInfo = {};
    pipelineCreateInfo.sType =
@@ -93,6 +124,7 @@ void ComputeSystem::createPipeline() {
 
 void ComputeSystem::createShaderModule(const std::string &compFilepath) {
    auto compCode = readFile(compFilepath);
+   reflectLocalSize(compCode);
    VkShaderModuleCreateInfo createInfo{};
    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
    createInfo.codeSize = compCode.size();
@@ -122,11 +154,139 @@ std::vector<char> ComputeSystem::readFile(const std::string &filepath) {
    return buffer;
 }
 
-void ComputeSystem::dispatch(int width, int height, int channels,
-                             VkDescriptorSet &DescriptorSet,
-                             VkCommandBuffer &CmdBuffer) {
+// Reads the workgroup size out of the SPIR-V module, so callers never
+// have to mirror the shader's layout. A WorkgroupSize built-in wins over
+// the LocalSize execution mode, and its components may be specialization
+// constants (local_size_x_id), which are resolved against the values
+// this pipeline is created with.
+void ComputeSystem::reflectLocalSize(const std::vector<char> &code) {
+   constexpr uint32_t SpvMagicNumber = 0x07230203;
+   constexpr uint32_t SpvOpExecutionMode = 16;
+   constexpr uint32_t SpvOpConstant = 43;
+   constexpr uint32_t SpvOpConstantComposite = 44;
+   constexpr uint32_t SpvOpSpecConstant = 50;
+   constexpr uint32_t SpvOpSpecConstantComposite = 51;
+   constexpr uint32_t SpvOpDecorate = 71;
+   constexpr uint32_t SpvExecutionModeLocalSize = 17;
+   constexpr uint32_t SpvDecorationSpecId = 1;
+   constexpr uint32_t SpvDecorationBuiltIn = 11;
+   constexpr uint32_t SpvBuiltInWorkgroupSize = 25;
+
+   std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+   std::memcpy(words.data(), code.data(), words.size() * sizeof(uint32_t));
+   if (words.size() < 5 || words[0] != SpvMagicNumber) {
+      throw std::runtime_error("invalid SPIR-V module");
+   }
+
+   std::unordered_map<uint32_t, uint32_t> constants;
+   std::unordered_map<uint32_t, uint32_t> specIds;
+   std::unordered_map<uint32_t, std::vector<uint32_t>> composites;
+   uint32_t workgroupSizeId = 0;
+
+   size_t i = 5;
+   while (i < words.size()) {
+      uint32_t wordCount = words[i] >> 16;
+      uint32_t opcode = words[i] & 0xffff;
+      if (wordCount == 0 || i + wordCount > words.size()) {
+         throw std::runtime_error("malformed SPIR-V module");
+      }
+      const uint32_t *op = &words[i + 1];
+      switch (opcode) {
+         case SpvOpExecutionMode:
+            if (wordCount >= 6 && op[1] == SpvExecutionModeLocalSize) {
+               localSize[0] = op[2];
+               localSize[1] = op[3];
+               localSize[2] = op[4];
+               for (bool &reflected : localSizeReflected) reflected = true;
+            }
+            break;
+         case SpvOpDecorate:
+            if (wordCount >= 4 && op[1] == SpvDecorationSpecId) {
+               specIds[op[0]] = op[2];
+            }
+            if (wordCount >= 4 && op[1] == SpvDecorationBuiltIn &&
+                op[2] == SpvBuiltInWorkgroupSize) {
+               workgroupSizeId = op[0];
+            }
+            break;
+         case SpvOpConstant:
+         case SpvOpSpecConstant:
+            if (wordCount >= 4) constants[op[1]] = op[2];
+            break;
+         case SpvOpConstantComposite:
+         case SpvOpSpecConstantComposite:
+            composites[op[1]].assign(op + 2, op + wordCount - 1);
+            break;
+      }
+      i += wordCount;
+   }
+
+   auto found = composites.find(workgroupSizeId);
+   if (workgroupSizeId == 0 || found == composites.end() ||
+       found->second.size() != 3) {
+      return;
+   }
+   for (int axis = 0; axis < 3; ++axis) {
+      uint32_t id = found->second[axis];
+      auto specId = specIds.find(id);
+      if (specId != specIds.end() &&
+          specId->second < specialization.size()) {
+         localSize[axis] = specialization[specId->second];
+         localSizeReflected[axis] = true;
+      } else if (constants.count(id)) {
+         localSize[axis] = constants[id];
+         localSizeReflected[axis] = true;
+      }
+   }
+}
+
+void ComputeSystem::checkDispatch(uint32_t width, uint32_t height,
+                                  uint32_t depth,
+                                  const uint32_t groups[3]) {
+#ifndef NDEBUG
+   const uint32_t size[3] = {width, height, depth};
+   const char axis[3] = {'x', 'y', 'z'};
+   for (int i = 0; i < 3; ++i) {
+      // x and y are texel extents, a local size of 1 there means it was
+      // not found in the module. The same dispatches are recorded every
+      // step, so each pipeline only warns once.
+      uint32_t launched = groups[i] * localSize[i];
+      if (!dispatchWarned && i < 2 && !localSizeReflected[i] &&
+          size[i] > 1) {
+         dispatchWarned = true;
+         std::cerr << "compute: no local size reflected on " << axis[i]
+                   << ", " << groups[i] << " workgroups of one invocation"
+                   << std::endl;
+      } else if (!dispatchWarned && localSize[i] > 1 &&
+                 launched - size[i] >= localSize[i] / 2) {
+         dispatchWarned = true;
+         std::cerr << "compute: " << launched - size[i] << " of the "
+                   << launched << " invocations on " << axis[i]
+                   << " are idle (local size " << localSize[i] << ")"
+                   << std::endl;
+      }
+      if (groups[i] >
+          lveDevice.properties.limits.maxComputeWorkGroupCount[i]) {
+         std::cerr << "compute: " << groups[i] << " workgroups on "
+                   << axis[i] << " exceeds the device limit of "
+                   << lveDevice.properties.limits
+                          .maxComputeWorkGroupCount[i]
+                   << std::endl;
+      }
+   }
+#endif
+}
+
+void ComputeSystem::bind(VkDescriptorSet &DescriptorSet,
+                         VkCommandBuffer &CmdBuffer) {
+   if (bindedCmdBuffer != CmdBuffer) {
+      bindedCmdBuffer = CmdBuffer;
+      bindedPipeline = VK_NULL_HANDLE;
+      bindedDescriptorSet = VK_NULL_HANDLE;
+   }
    if (bindedPipeline != this->computePipeline) {
       bindedPipeline = this->computePipeline;
+      bindedDescriptorSet = VK_NULL_HANDLE;
       vkCmdBindPipeline(CmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
                         this->computePipeline);
    }
@@ -136,7 +296,59 @@ void ComputeSystem::dispatch(int width, int height, int channels,
                               this->pipelineLayout, 0, 1, &DescriptorSet,
                               0, nullptr);
    }
-   vkCmdDispatch(CmdBuffer, width, height, channels);
+}
+
+void ComputeSystem::dispatch(uint32_t width, uint32_t height,
+                             uint32_t depth,
+                             VkDescriptorSet &DescriptorSet,
+                             VkCommandBuffer &CmdBuffer) {
+   bind(DescriptorSet, CmdBuffer);
+   const uint32_t groups[3] = {
+       (width + localSize[0] - 1) / localSize[0],
+       (height + localSize[1] - 1) / localSize[1],
+       (depth + localSize[2] - 1) / localSize[2],
+   };
+   checkDispatch(width, height, depth, groups);
+   vkCmdDispatch(CmdBuffer, groups[0], groups[1], groups[2]);
+}
+
+void ComputeSystem::dispatch(uint32_t width, uint32_t height,
+                             uint32_t depth,
+                             VkDescriptorSet &DescriptorSet,
+                             VkCommandBuffer &CmdBuffer,
+                             const void *pushData) {
+   assert(pushConstantSize != 0 &&
+          "Pipeline was created without push constants");
+   vkCmdPushConstants(CmdBuffer, this->pipelineLayout,
+                      VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize,
+                      pushData);
+   dispatch(width, height, depth, DescriptorSet, CmdBuffer);
+}
+
+void ComputeSystem::dispatchIndirect(VkBuffer buffer, VkDeviceSize offset,
+                                     VkDescriptorSet &DescriptorSet,
+                                     VkCommandBuffer &CmdBuffer,
+                                     const void *pushData) {
+   if (pushData != nullptr) {
+      assert(pushConstantSize != 0 &&
+             "Pipeline was created without push constants");
+      vkCmdPushConstants(CmdBuffer, this->pipelineLayout,
+                         VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize,
+                         pushData);
+   }
+#ifndef NDEBUG
+   // The indirect workgroup counts are worked out from get_local_size.
+   for (int i = 0; i < 3 && !dispatchWarned; ++i) {
+      if (!localSizeReflected[i]) {
+         dispatchWarned = true;
+         std::cerr << "compute: no local size reflected for an indirect "
+                      "dispatch"
+                   << std::endl;
+      }
+   }
+#endif
+   bind(DescriptorSet, CmdBuffer);
+   vkCmdDispatchIndirect(CmdBuffer, buffer, offset);
 }
 
 void ComputeSystem::await(VkCommandBuffer &CmdBuffer) {
@@ -156,14 +368,18 @@ void ComputeSystem::await(VkCommandBuffer &CmdBuffer) {
    vkQueueSubmit(Queue, 1, &submitInfo, this->Fence);
    vkWaitForFences(lveDevice.device(), 1, &this->Fence, true,
                    uint64_t(-1));
-   vkFreeCommandBuffers(lveDevice.device(), lveDevice.getCommandPool(), 1,
-                        &CmdBuffer);
+   vkFreeCommandBuffers(lveDevice.device(),
+                        lveDevice.getComputeCommandPool(), 1, &CmdBuffer);
+   if (bindedCmdBuffer == CmdBuffer) {
+      bindedCmdBuffer = VK_NULL_HANDLE;
+   }
 }
 
-void ComputeSystem::instant_dispatch(int width, int height, int channels,
+void ComputeSystem::instant_dispatch(uint32_t width, uint32_t height,
+                                     uint32_t depth,
                                      VkDescriptorSet &DescriptorSet) {
-   VkCommandBuffer CmdBuffer = lveDevice.beginSingleTimeCommands();
-   dispatch(width, height, channels, DescriptorSet, CmdBuffer);
+   VkCommandBuffer CmdBuffer = lveDevice.beginSingleTimeComputeCommands();
+   dispatch(width, height, depth, DescriptorSet, CmdBuffer);
    lveDevice.endCommandBuffer(CmdBuffer);
    await(CmdBuffer);
 }
@@ -8,20 +8,38 @@ namespace lve {
 
 class ComputeSystem {
   public:
+   // specialization[i] is bound to the shader's constant_id = i.
+   // pushConstantSize is the size of the shader's push_constant block,
+   // 0 when it has none.
    ComputeSystem(LveDevice &device,
                  const std::vector<VkDescriptorSetLayout>,
-                 const std::string &);
+                 const std::string &,
+                 const std::vector<uint32_t> &specialization = {},
+                 uint32_t pushConstantSize = 0);
    ComputeSystem(ComputeSystem &&) = delete;
    ComputeSystem(const ComputeSystem &) = delete;
    ComputeSystem &operator=(ComputeSystem &&) = delete;
    ComputeSystem &operator=(const ComputeSystem &) = delete;
    ~ComputeSystem();
 
-   void dispatch(int width, int height, int channels,
+   // Sizes are in invocations, the workgroup count is derived from the
+   // local size declared in the shader.
+   void dispatch(uint32_t width, uint32_t height, uint32_t depth,
                  VkDescriptorSet &DescriptorSet,
                  VkCommandBuffer &CmdBuffer);
+   // Same, pushing pushConstantSize bytes of pushData first.
+   void dispatch(uint32_t width, uint32_t height, uint32_t depth,
+                 VkDescriptorSet &DescriptorSet,
+                 VkCommandBuffer &CmdBuffer, const void *pushData);
+   // Workgroup counts are read on the device from the
+   // VkDispatchIndirectCommand at offset in buffer. pushData may be
+   // null when the pipeline has no push constants.
+   void dispatchIndirect(VkBuffer buffer, VkDeviceSize offset,
+                         VkDescriptorSet &DescriptorSet,
+                         VkCommandBuffer &CmdBuffer,
+                         const void *pushData = nullptr);
    void await(VkCommandBuffer &CmdBuffer);
-   void instant_dispatch(int width, int height, int channels,
+   void instant_dispatch(uint32_t width, uint32_t height, uint32_t depth,
                          VkDescriptorSet &DescriptorSet);
    VkPipeline get_pipeline() {
       return this->computePipeline;
@@ -29,6 +47,14 @@ class ComputeSystem {
    VkPipelineLayout get_pipeline_layout() {
       return this->pipelineLayout;
    }
+   const uint32_t *get_local_size() const {
+      return this->localSize;
+   }
+   // Must be called before recording again into a command buffer that
+   // was already recorded, the bind state cached for it is stale.
+   static void forget_bindings() {
+      bindedCmdBuffer = VK_NULL_HANDLE;
+   }
 
   private:
    LveDevice &lveDevice;
@@ -36,13 +62,26 @@ class ComputeSystem {
    VkPipeline computePipeline;
    VkPipelineLayout pipelineLayout;
    VkFence Fence;
+   uint32_t localSize[3] = {1, 1, 1};
+   // Axes whose local size was found in the module, see checkDispatch.
+   bool localSizeReflected[3] = {false, false, false};
+   bool dispatchWarned = false;
+   std::vector<uint32_t> specialization;
+   uint32_t pushConstantSize;
 
    void createFence();
    void createPipelineLayout(const std::vector<VkDescriptorSetLayout>);
    void createPipeline();
    void createShaderModule(const std::string &);
    std::vector<char> readFile(const std::string &filepath);
+   void reflectLocalSize(const std::vector<char> &code);
+   void bind(VkDescriptorSet &DescriptorSet, VkCommandBuffer &CmdBuffer);
+   void checkDispatch(uint32_t width, uint32_t height, uint32_t depth,
+                      const uint32_t groups[3]);
 
+   // Bind state is per command buffer, so it is forgotten whenever
+   // recording moves to another one.
+   static VkCommandBuffer bindedCmdBuffer;
    static VkPipeline bindedPipeline;
    static VkDescriptorSet bindedDescriptorSet;
 };
@@ -0,0 +1,502 @@
+#include "cpu_ocean.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace lve {
+
+namespace {
+
+// As SimulationOutput in second_app.hpp.
+constexpr uint32_t outputDerivatives = 1;
+constexpr uint32_t outputTurbulence = 2;
+
+constexpr float PI = 3.1415926f;
+constexpr double TWO_PI = 6.283185307179586;
+
+// The spectrum functions of init_spectrum.comp, term for term.
+
+float Frequency(float k, float g, float depth) {
+   return std::sqrt(g * k * std::tanh(std::min(k * depth, 20.f)));
+}
+
+float FrequencyDerivative(float k, float g, float depth) {
+   float th = std::tanh(std::min(k * depth, 20.f));
+   float ch = std::cosh(k * depth);
+   return g * (depth * k / ch / ch + th) / Frequency(k, g, depth) / 2;
+}
+
+float NormalisationFactor(float s) {
+   float s2 = s * s;
+   float s3 = s2 * s;
+   float s4 = s3 * s;
+   if (s < 5) {
+      return -0.000564f * s4 + 0.00776f * s3 - 0.044f * s2 + 0.192f * s +
+             0.163f;
+   }
+   return -4.80e-08f * s4 + 1.07e-05f * s3 - 9.53e-04f * s2 +
+          5.90e-02f * s + 3.93e-01f;
+}
+
+float Cosine2s(float theta, float s) {
+   return NormalisationFactor(s) *
+          std::pow(std::abs(std::cos(0.5f * theta)), 2 * s);
+}
+
+float SpreadPower(float omega, float peakOmega) {
+   if (omega > peakOmega) {
+      return 9.77f * std::pow(std::abs(omega / peakOmega), -2.5f);
+   }
+   return 6.97f * std::pow(std::abs(omega / peakOmega), 5.f);
+}
+
+float DirectionSpectrum(float theta, float omega,
+                        const CpuSpectrumParameters &pars) {
+   float s = SpreadPower(omega, pars.peakOmega) +
+             16 * std::tanh(std::min(omega / pars.peakOmega, 20.f)) *
+                 pars.swell * pars.swell;
+   return glm::mix(2 / 3.1415f * std::cos(theta) * std::cos(theta),
+                   Cosine2s(theta - pars.angle, s), pars.spreadBlend);
+}
+
+float TMACorrection(float omega, float g, float depth) {
+   float omegaH = omega * std::sqrt(depth / g);
+   if (omegaH <= 1) return 0.5f * omegaH * omegaH;
+   if (omegaH < 2) return 1.f - 0.5f * (2.f - omegaH) * (2.f - omegaH);
+   return 1;
+}
+
+float JONSWAP(float omega, float g, float depth,
+              const CpuSpectrumParameters &pars) {
+   float sigma = omega <= pars.peakOmega ? 0.07f : 0.09f;
+   float r = std::exp(-(omega - pars.peakOmega) *
+                      (omega - pars.peakOmega) / 2 / sigma / sigma /
+                      pars.peakOmega / pars.peakOmega);
+   float oneOverOmega = 1 / omega;
+   float peakOmegaOverOmega = pars.peakOmega / omega;
+   return pars.scale * TMACorrection(omega, g, depth) * pars.alpha * g *
+          g * oneOverOmega * oneOverOmega * oneOverOmega * oneOverOmega *
+          oneOverOmega *
+          std::exp(-1.25f * peakOmegaOverOmega * peakOmegaOverOmega *
+                   peakOmegaOverOmega * peakOmegaOverOmega) *
+          std::pow(std::abs(pars.gamma), r);
+}
+
+float ShortWavesFade(float kLength, const CpuSpectrumParameters &pars) {
+   return std::exp(-pars.shortWavesFade * pars.shortWavesFade * kLength *
+                   kLength);
+}
+
+glm::vec2 UniformToGaussian(float u1, float u2) {
+   float R = std::sqrt(-2.f * std::log(u1));
+   float theta = 2.f * PI * u2;
+   return glm::vec2(R * std::cos(theta), R * std::sin(theta));
+}
+
+float hash(uint32_t n) {
+   n = (n << 13U) ^ n;
+   n = n * (n * n * 15731U + 0x789221U) + 0x76312589U;
+   return float(n & uint32_t(0x7fffffffU)) / float(0x7fffffff);
+}
+
+glm::vec2 comp_mul(glm::vec2 a, glm::vec2 b) {
+   return glm::vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// lo = p + w q and hi = p - w q for floats interleaved complex numbers,
+// a multiple of 4. w q is evaluated as comp_mul in the shaders.
+inline void butterfly(const float *p, const float *q, float *lo,
+                      float *hi, glm::vec2 w, size_t floats) {
+   size_t i = 0;
+#if defined(__AVX__)
+   const __m256 wr8 = _mm256_set1_ps(w.x);
+   const __m256 wi8 = _mm256_set1_ps(w.y);
+   for (; i + 8 <= floats; i += 8) {
+      __m256 vq = _mm256_loadu_ps(q + i);
+      __m256 vp = _mm256_loadu_ps(p + i);
+      // (re wr - im wi, im wr + re wi) for each pair.
+      __m256 wq = _mm256_addsub_ps(
+          _mm256_mul_ps(vq, wr8),
+          _mm256_mul_ps(_mm256_permute_ps(vq, 0xB1), wi8));
+      _mm256_storeu_ps(lo + i, _mm256_add_ps(vp, wq));
+      _mm256_storeu_ps(hi + i, _mm256_sub_ps(vp, wq));
+   }
+#endif
+#if defined(__AVX__) || defined(__SSE2__)
+   const __m128 wr4 = _mm_set1_ps(w.x);
+   const __m128 wi4 = _mm_set1_ps(w.y);
+   const __m128 sign = _mm_setr_ps(-1.f, 1.f, -1.f, 1.f);
+   for (; i + 4 <= floats; i += 4) {
+      __m128 vq = _mm_loadu_ps(q + i);
+      __m128 vp = _mm_loadu_ps(p + i);
+      __m128 swapped = _mm_shuffle_ps(vq, vq, _MM_SHUFFLE(2, 3, 0, 1));
+      __m128 wq = _mm_add_ps(
+          _mm_mul_ps(vq, wr4),
+          _mm_mul_ps(_mm_mul_ps(swapped, wi4), sign));
+      _mm_storeu_ps(lo + i, _mm_add_ps(vp, wq));
+      _mm_storeu_ps(hi + i, _mm_sub_ps(vp, wq));
+   }
+#elif defined(__ARM_NEON)
+   const float32x4_t wr4 = vdupq_n_f32(w.x);
+   const float32x4_t wi4 = vdupq_n_f32(w.y);
+   const float sign_values[4] = {-1.f, 1.f, -1.f, 1.f};
+   const float32x4_t sign = vld1q_f32(sign_values);
+   for (; i + 4 <= floats; i += 4) {
+      float32x4_t vq = vld1q_f32(q + i);
+      float32x4_t vp = vld1q_f32(p + i);
+      float32x4_t wq =
+          vaddq_f32(vmulq_f32(vq, wr4),
+                    vmulq_f32(vmulq_f32(vrev64q_f32(vq), wi4), sign));
+      vst1q_f32(lo + i, vaddq_f32(vp, wq));
+      vst1q_f32(hi + i, vsubq_f32(vp, wq));
+   }
+#endif
+   for (; i < floats; i += 2) {
+      glm::vec2 wq = comp_mul(w, glm::vec2(q[i], q[i + 1]));
+      lo[i] = p[i] + wq.x;
+      lo[i + 1] = p[i + 1] + wq.y;
+      hi[i] = p[i] - wq.x;
+      hi[i + 1] = p[i + 1] - wq.y;
+   }
+}
+
+// Every stage of stockham_fft.comp over n elements of stride floats,
+// ping ponging between a and b. Returns the one holding the result.
+float *fft(float *a, float *b, uint32_t n, uint32_t logN, size_t stride,
+           const glm::vec2 *twiddles) {
+   uint32_t half = n / 2;
+   for (uint32_t stage = 0; stage < logN; ++stage) {
+      uint32_t span = n >> (stage + 1);
+      for (uint32_t j = 0; j < half; ++j) {
+         uint32_t i = 2 * span * (j / span) + j % span;
+         butterfly(a + i * stride, a + (i + span) * stride, b + j * stride,
+                   b + (j + half) * stride, twiddles[(j / span) * span],
+                   stride);
+      }
+      std::swap(a, b);
+   }
+   return a;
+}
+
+// Columns per vertical FFT job, the width each butterfly is vectorized
+// over.
+constexpr uint32_t stripWidth = 16;
+
+// Scratch of the calling thread, grown as needed.
+std::vector<glm::vec4> &scratch(size_t index, size_t texels) {
+   thread_local std::vector<glm::vec4> buffers[6];
+   if (buffers[index].size() < texels) buffers[index].resize(texels);
+   return buffers[index];
+}
+
+}  // namespace
+
+CpuThreadPool::CpuThreadPool(unsigned threads) {
+   for (unsigned i = 1; i < threads; ++i) {
+      workers.emplace_back(&CpuThreadPool::work, this);
+   }
+}
+
+CpuThreadPool::~CpuThreadPool() {
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+   }
+   wake.notify_all();
+   for (std::thread &worker : workers) worker.join();
+}
+
+void CpuThreadPool::parallelFor(size_t count,
+                                const std::function<void(size_t)> &job) {
+   if (workers.empty() || count < 2) {
+      for (size_t i = 0; i < count; ++i) job(i);
+      return;
+   }
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->job = &job;
+      this->count = count;
+      next = 0;
+      running = workers.size();
+      ++generation;
+   }
+   wake.notify_all();
+   runJobs();
+   // Every worker has to leave before job goes out of scope.
+   std::unique_lock<std::mutex> lock(mutex);
+   done.wait(lock, [&] { return running == 0; });
+   this->job = nullptr;
+}
+
+void CpuThreadPool::work() {
+   uint64_t seen = 0;
+   std::unique_lock<std::mutex> lock(mutex);
+   for (;;) {
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+      lock.unlock();
+      runJobs();
+      lock.lock();
+      if (--running == 0) done.notify_one();
+   }
+}
+
+void CpuThreadPool::runJobs() {
+   for (size_t i; (i = next.fetch_add(1)) < count;) (*job)(i);
+}
+
+CpuOcean::CpuOcean(std::vector<CpuCascadeSettings> settings,
+                   uint32_t features, unsigned threads)
+    : derivativesOn((features & (outputDerivatives | outputTurbulence)) !=
+                    0),
+      turbulenceOn((features & outputTurbulence) != 0),
+      pool(std::max(threads, 1u)) {
+   for (const CpuCascadeSettings &s : settings) {
+      if (s.size < 4 || (s.size & (s.size - 1)) != 0) {
+         throw std::runtime_error("cpu cascade sizes must be powers of two");
+      }
+      cascade_state cascade;
+      cascade.settings = s;
+      uint32_t n = s.size;
+      cascade.logSize = 0;
+      while ((1u << cascade.logSize) < n) ++cascade.logSize;
+
+      // As the spectrum_band of second_app.cpp.
+      float deltaK = 2 * PI / s.lengthScale;
+      float radius = std::ceil(s.cutoffHigh / deltaK);
+      uint32_t r = radius < n / 2 ? uint32_t(radius) : n / 2;
+      cascade.bandFirst = n / 2 - r;
+      cascade.bandLast = std::min(n / 2 + r, n - 1);
+
+      cascade.twiddles.resize(n / 2);
+      for (uint32_t k = 0; k < n / 2; ++k) {
+         double angle = -2 * 3.14159265358979323846 * k / n;
+         cascade.twiddles[k] = glm::vec2(std::cos(angle), std::sin(angle));
+      }
+      size_t texels = size_t(n) * n;
+      cascade.wavesData.resize(texels);
+      cascade.h0.resize(texels);
+      cascade.field[0].resize(texels);
+      cascade.displacement.resize(texels);
+      if (derivativesOn) {
+         cascade.field[1].resize(texels);
+         cascade.derivatives.resize(texels);
+      }
+      if (turbulenceOn) cascade.turbulence.assign(texels, 0.f);
+      cascades.push_back(std::move(cascade));
+   }
+}
+
+void CpuOcean::initSpectrum(const CpuSpectrumParameters (&spectrums)[2]) {
+   // H0K of every cascade, which the conjugate pairing reads across rows.
+   std::vector<std::vector<glm::vec2>> h0k(cascades.size());
+   std::vector<std::pair<size_t, uint32_t>> rows;
+   for (size_t c = 0; c < cascades.size(); ++c) {
+      uint32_t n = cascades[c].settings.size;
+      h0k[c].resize(size_t(n) * n);
+      for (uint32_t y = 0; y < n; ++y) rows.emplace_back(c, y);
+   }
+
+   pool.parallelFor(rows.size(), [&](size_t job) {
+      auto [c, y] = rows[job];
+      cascade_state &cascade = cascades[c];
+      const CpuCascadeSettings &ubo = cascade.settings;
+      uint32_t n = ubo.size;
+      float g = ubo.gravityAcceleration;
+      float deltaK = 2 * PI / ubo.lengthScale;
+      for (uint32_t x = 0; x < n; ++x) {
+         size_t texel = size_t(y) * n + x;
+         int nx = int(x) - int(n) / 2;
+         int nz = int(y) - int(n) / 2;
+         glm::vec2 k = glm::vec2(nx, nz) * deltaK;
+         float kLength = glm::length(k);
+         uint32_t seed = x + n * y + n;
+         if (kLength <= ubo.cutoffHigh && kLength >= ubo.cutoffLow) {
+            float kAngle = std::atan2(k.y, k.x);
+            float omega = Frequency(kLength, g, ubo.depth);
+            cascade.wavesData[texel] =
+                glm::vec4(k.x, 1 / kLength, k.y, omega);
+            float dOmegadk = FrequencyDerivative(kLength, g, ubo.depth);
+            float spectrum =
+                JONSWAP(omega, g, ubo.depth, spectrums[0]) *
+                DirectionSpectrum(kAngle, omega, spectrums[0]) *
+                ShortWavesFade(kLength, spectrums[0]);
+            if (spectrums[1].scale > 0) {
+               spectrum += JONSWAP(omega, g, ubo.depth, spectrums[1]) *
+                           DirectionSpectrum(kAngle, omega, spectrums[1]) *
+                           ShortWavesFade(kLength, spectrums[1]);
+            }
+            seed += uint32_t(hash(seed) * 10);
+            glm::vec4 uniformRandSamples(hash(seed), hash(seed * 2),
+                                         hash(seed * 3), hash(seed * 4));
+            glm::vec2 gauss(UniformToGaussian(uniformRandSamples.z,
+                                              uniformRandSamples.w)
+                                .x,
+                            UniformToGaussian(uniformRandSamples.x,
+                                              uniformRandSamples.y)
+                                .y);
+            h0k[c][texel] =
+                gauss * std::sqrt(2 * spectrum * std::abs(dOmegadk) /
+                                  kLength * deltaK * deltaK);
+         } else {
+            h0k[c][texel] = glm::vec2(0);
+            cascade.wavesData[texel] = glm::vec4(k.x, 1, k.y, 1);
+         }
+      }
+   });
+
+   pool.parallelFor(rows.size(), [&](size_t job) {
+      auto [c, y] = rows[job];
+      cascade_state &cascade = cascades[c];
+      uint32_t n = cascade.settings.size;
+      const glm::vec2 *minusRow = &h0k[c][size_t((n - y) % n) * n];
+      for (uint32_t x = 0; x < n; ++x) {
+         glm::vec2 k = h0k[c][size_t(y) * n + x];
+         glm::vec2 minusK = minusRow[(n - x) % n];
+         cascade.h0[size_t(y) * n + x] =
+             glm::vec4(k.x, k.y, minusK.x, -minusK.y);
+      }
+   });
+}
+
+void CpuOcean::step(const std::vector<double> &times, float deltaTime,
+                    float lambda, uint32_t mask) {
+   const size_t fields = derivativesOn ? 2 : 1;
+
+   // timed_spectrum.comp and the horizontal FFT, one row per job.
+   std::vector<std::pair<size_t, uint32_t>> rows;
+   for (size_t c = 0; c < cascades.size(); ++c) {
+      if ((mask & (1u << c)) == 0) continue;
+      for (uint32_t y = 0; y < cascades[c].settings.size; ++y) {
+         rows.emplace_back(c, y);
+      }
+   }
+   pool.parallelFor(rows.size(), [&](size_t job) {
+      auto [c, y] = rows[job];
+      cascade_state &cascade = cascades[c];
+      uint32_t n = cascade.settings.size;
+      size_t first = size_t(y) * n;
+      if (y < cascade.bandFirst || y > cascade.bandLast) {
+         for (size_t f = 0; f < fields; ++f) {
+            std::fill_n(cascade.field[f].begin() + first, n, glm::vec4(0));
+         }
+         return;
+      }
+      for (uint32_t x = 0; x < n; ++x) {
+         glm::vec4 wave = cascade.wavesData[first + x];
+         float phase =
+             float(std::remainder(double(wave.w) * times[c], TWO_PI));
+         glm::vec2 exponent(std::cos(phase), std::sin(phase));
+         glm::vec4 h0 = cascade.h0[first + x];
+         glm::vec2 h = comp_mul(glm::vec2(h0.x, h0.y), exponent) +
+                       comp_mul(glm::vec2(h0.z, h0.w),
+                                glm::vec2(exponent.x, -exponent.y));
+         glm::vec2 ih(-h.y, h.x);
+
+         glm::vec2 displacementX = ih * wave.x * wave.y;
+         glm::vec2 displacementY = h;
+         glm::vec2 displacementZ = ih * wave.z * wave.y;
+         glm::vec2 displacementZ_dx = -h * wave.x * wave.z * wave.y;
+         cascade.field[0][first + x] =
+             glm::vec4(displacementX.x - displacementZ.y,
+                       displacementY.x - displacementZ_dx.y,
+                       displacementX.y + displacementZ.x,
+                       displacementY.y + displacementZ_dx.x);
+         if (!derivativesOn) continue;
+
+         glm::vec2 displacementX_dx = -h * wave.x * wave.x * wave.y;
+         glm::vec2 displacementY_dx = ih * wave.x;
+         glm::vec2 displacementY_dz = ih * wave.z;
+         glm::vec2 displacementZ_dz = -h * wave.z * wave.z * wave.y;
+         cascade.field[1][first + x] =
+             glm::vec4(displacementY_dx.x - displacementY_dz.y,
+                       displacementY_dx.y + displacementY_dz.x,
+                       displacementX_dx.x - displacementZ_dz.y,
+                       displacementX_dx.y + displacementZ_dz.x);
+      }
+      std::vector<glm::vec4> &other = scratch(0, n);
+      for (size_t f = 0; f < fields; ++f) {
+         float *row = &cascade.field[f][first].x;
+         float *result =
+             fft(row, &other[0].x, n, cascade.logSize, 4,
+                 cascade.twiddles.data());
+         if (result != row) {
+            std::memcpy(row, result, n * sizeof(glm::vec4));
+         }
+      }
+   });
+
+   // The vertical FFT, inv_perm.comp and texture_merger.comp, one strip
+   // of columns per job.
+   std::vector<std::pair<size_t, uint32_t>> strips;
+   for (size_t c = 0; c < cascades.size(); ++c) {
+      if ((mask & (1u << c)) == 0) continue;
+      for (uint32_t x = 0; x < cascades[c].settings.size; x += stripWidth) {
+         strips.emplace_back(c, x);
+      }
+   }
+   pool.parallelFor(strips.size(), [&](size_t job) {
+      auto [c, x0] = strips[job];
+      cascade_state &cascade = cascades[c];
+      uint32_t n = cascade.settings.size;
+      uint32_t width = std::min(stripWidth, n - x0);
+      glm::vec4 *column[2] = {};
+      for (size_t f = 0; f < fields; ++f) {
+         std::vector<glm::vec4> &a = scratch(1 + 2 * f, size_t(n) * width);
+         std::vector<glm::vec4> &b = scratch(2 + 2 * f, size_t(n) * width);
+         for (uint32_t y = 0; y < n; ++y) {
+            std::memcpy(&a[size_t(y) * width],
+                        &cascade.field[f][size_t(y) * n + x0],
+                        width * sizeof(glm::vec4));
+         }
+         column[f] = reinterpret_cast<glm::vec4 *>(
+             fft(&a[0].x, &b[0].x, n, cascade.logSize, 4 * width,
+                 cascade.twiddles.data()));
+      }
+      for (uint32_t y = 0; y < n; ++y) {
+         for (uint32_t dx = 0; dx < width; ++dx) {
+            uint32_t x = x0 + dx;
+            size_t texel = size_t(y) * n + x;
+            float sign = 1.f - 2.f * ((x + y) % 2);
+            glm::vec4 disp_tur = column[0][size_t(y) * width + dx] * sign;
+            glm::vec4 derv(0);
+            if (derivativesOn) {
+               derv = column[1][size_t(y) * width + dx] * sign;
+            }
+            float turbulence = 0;
+            if (turbulenceOn) {
+               float Dxx = derv.z;
+               float Dzz = derv.w;
+               float Dxz = disp_tur.w;
+               float jacobian = (1 + lambda * Dxx) * (1 + lambda * Dzz) -
+                                lambda * lambda * Dxz * Dxz;
+               turbulence = std::min(
+                   jacobian, cascade.turbulence[texel] +
+                                 deltaTime * 0.5f /
+                                     std::max(jacobian, 0.5f));
+               cascade.turbulence[texel] = turbulence;
+            }
+            cascade.displacement[texel] =
+                glm::vec4(lambda * disp_tur.x, disp_tur.y,
+                          lambda * disp_tur.z, turbulence);
+            if (derivativesOn) {
+               cascade.derivatives[texel] =
+                   glm::vec4(derv.x, derv.y, derv.z * lambda,
+                             derv.w * lambda);
+            }
+         }
+      }
+   });
+}
+
+}  // namespace lve
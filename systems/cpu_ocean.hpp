@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace lve {
+
+// As SpectrumParameters in init_spectrum.comp.
+struct CpuSpectrumParameters {
+   float scale;
+   float angle;
+   float spreadBlend;
+   float swell;
+   float alpha;
+   float peakOmega;
+   float gamma;
+   float shortWavesFade;
+};
+
+// The fields of a cascade's comp_ubo the spectrum depends on.
+struct CpuCascadeSettings {
+   float lengthScale;
+   float cutoffHigh;
+   float cutoffLow;
+   float gravityAcceleration;
+   float depth;
+   // A power of two, 4 or more.
+   uint32_t size;
+};
+
+// Fixed set of worker threads. The calling thread takes part in every
+// parallelFor, so threads counts it.
+class CpuThreadPool {
+  public:
+   explicit CpuThreadPool(unsigned threads);
+   ~CpuThreadPool();
+
+   CpuThreadPool(const CpuThreadPool &) = delete;
+   CpuThreadPool &operator=(const CpuThreadPool &) = delete;
+
+   // Calls job(i) for every i < count, in no particular order, and
+   // returns once every call has.
+   void parallelFor(size_t count, const std::function<void(size_t)> &job);
+   unsigned size() const {
+      return workers.size() + 1;
+   }
+
+  private:
+   std::vector<std::thread> workers;
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable done;
+   const std::function<void(size_t)> *job = nullptr;
+   size_t count = 0;
+   std::atomic<size_t> next{0};
+   // Workers still in the current parallelFor.
+   size_t running = 0;
+   uint64_t generation = 0;
+   bool stopping = false;
+
+   void work();
+   void runJobs();
+};
+
+// The simulation of SecondApp on the CPU, for machines without a
+// usable GPU and to validate the compute shaders against: the same
+// spectrum, timed spectrum, inverse FFT and merge, in fp32 and with the
+// same operation order, so it matches the full precision GPU path up to
+// the differences between the two's transcendental functions. The
+// waves advance by exp(i omega t), omega t taken in double.
+// Rows and cascades are spread over a thread pool and the butterflies
+// use AVX, SSE2 or NEON when the build targets them.
+class CpuOcean {
+  public:
+   // features is a mask of SimulationOutput, turbulence needs the
+   // derivatives.
+   CpuOcean(std::vector<CpuCascadeSettings> cascades, uint32_t features,
+            unsigned threads = std::thread::hardware_concurrency());
+
+   CpuOcean(const CpuOcean &) = delete;
+   CpuOcean &operator=(const CpuOcean &) = delete;
+
+   // init_spectrum.comp and conj_spectrum.comp for every cascade.
+   void initSpectrum(const CpuSpectrumParameters (&spectrums)[2]);
+   // timed_spectrum.comp, the inverse FFT and texture_merger.comp for
+   // the cascades with a bit set in mask, cascade c at times[c].
+   // deltaTime is the time since they were last updated, which the
+   // turbulence decays over.
+   void step(const std::vector<double> &times, float deltaTime,
+             float lambda, uint32_t mask = ~0u);
+
+   size_t cascadeCount() const {
+      return cascades.size();
+   }
+   // A cascade's outputs as the GPU writes them with fp16 outputs, row
+   // major. derivatives is empty without OutputDerivatives.
+   const std::vector<glm::vec4> &displacement(size_t cascade) const {
+      return cascades[cascade].displacement;
+   }
+   const std::vector<glm::vec4> &derivatives(size_t cascade) const {
+      return cascades[cascade].derivatives;
+   }
+
+  private:
+   struct cascade_state {
+      CpuCascadeSettings settings;
+      uint32_t logSize;
+      // Rows further than the cutoff from the center, all zero in the
+      // spectrum, in unshifted texel coordinates.
+      uint32_t bandFirst;
+      uint32_t bandLast;
+      // exp(-2 pi i k / size) for k < size / 2.
+      std::vector<glm::vec2> twiddles;
+      std::vector<glm::vec4> wavesData;
+      std::vector<glm::vec4> h0;
+      // The two fields the FFT runs on, as in timed_spectrum.comp.
+      std::vector<glm::vec4> field[2];
+      std::vector<float> turbulence;
+      std::vector<glm::vec4> displacement;
+      std::vector<glm::vec4> derivatives;
+   };
+
+   std::vector<cascade_state> cascades;
+   bool derivativesOn;
+   bool turbulenceOn;
+   CpuThreadPool pool;
+};
+
+}  // namespace lve
@@ -0,0 +1,159 @@
+#include "cpu_ocean_upload.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+// Bytes of a texel of texture, after checking a cascade's texels fit
+// one of its layers.
+VkDeviceSize texelBytes(const MyTextureData &texture, uint32_t layer,
+                        const std::vector<glm::vec4> &texels) {
+   if (size_t(texture.Width) * texture.Height != texels.size() ||
+       layer >= uint32_t(std::max(texture.Layers, 1))) {
+      throw std::runtime_error("cpu output does not fit the texture");
+   }
+   if (texture.Format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+      return 4 * sizeof(uint16_t);
+   }
+   if (texture.Format == VK_FORMAT_R32G32B32A32_SFLOAT) {
+      return sizeof(glm::vec4);
+   }
+   throw std::runtime_error(
+       "cpu outputs are only uploaded to fp16 and fp32 textures");
+}
+
+void packTexels(const std::vector<glm::vec4> &texels, VkDeviceSize bytes,
+                void *dst) {
+   if (bytes == sizeof(glm::vec4)) {
+      std::memcpy(dst, texels.data(), texels.size() * bytes);
+      return;
+   }
+   uint64_t *halves = static_cast<uint64_t *>(dst);
+   for (size_t i = 0; i < texels.size(); ++i) {
+      halves[i] = glm::packHalf4x16(texels[i]);
+   }
+}
+
+// Copies a whole layer from buffer at offset, between barriers against
+// any shader access on either side.
+void recordCopy(MyTextureData &texture, uint32_t layer, VkBuffer buffer,
+                VkDeviceSize offset, VkCommandBuffer cmd) {
+   VkImageMemoryBarrier barrier = {};
+   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   barrier.srcAccessMask =
+       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+   barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+   barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   barrier.image = texture.Image;
+   barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+   barrier.subresourceRange.baseArrayLayer = layer;
+   barrier.subresourceRange.levelCount = 1;
+   barrier.subresourceRange.layerCount = 1;
+   vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                        nullptr, 1, &barrier);
+
+   VkBufferImageCopy region = {};
+   region.bufferOffset = offset;
+   region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+   region.imageSubresource.baseArrayLayer = layer;
+   region.imageSubresource.layerCount = 1;
+   region.imageExtent.width = texture.Width;
+   region.imageExtent.height = texture.Height;
+   region.imageExtent.depth = 1;
+   vkCmdCopyBufferToImage(cmd, buffer, texture.Image,
+                          VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+   barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+   vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                        0, nullptr, 1, &barrier);
+}
+
+// Through the texture's own upload buffer, at the layer's offset.
+void recordLayerUpload(MyTextureData &texture, uint32_t layer,
+                       const std::vector<glm::vec4> &texels,
+                       VkCommandBuffer cmd) {
+   if (texture.UploadBuffer == VK_NULL_HANDLE) {
+      throw std::runtime_error("texture has no upload buffer");
+   }
+   VkDeviceSize bytes = texelBytes(texture, layer, texels);
+   VkDeviceSize offset = VkDeviceSize(layer) * texels.size() * bytes;
+
+   VkDevice device = texture.device.device();
+   void *map;
+   if (vkMapMemory(device, texture.UploadBufferMemory, 0, VK_WHOLE_SIZE, 0,
+                   &map) != VK_SUCCESS) {
+      throw std::runtime_error("failed to map upload buffer!");
+   }
+   packTexels(texels, bytes, static_cast<char *>(map) + offset);
+   VkMappedMemoryRange range = {};
+   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   range.memory = texture.UploadBufferMemory;
+   range.size = VK_WHOLE_SIZE;
+   vkFlushMappedMemoryRanges(device, 1, &range);
+   vkUnmapMemory(device, texture.UploadBufferMemory);
+
+   recordCopy(texture, layer, texture.UploadBuffer, offset, cmd);
+}
+
+}  // namespace
+
+void recordCpuUpload(const CpuOcean &ocean, size_t cascade,
+                     MyTextureData &displacement, MyTextureData &derivatives,
+                     uint32_t layer, VkCommandBuffer cmd) {
+   recordLayerUpload(displacement, layer, ocean.displacement(cascade), cmd);
+   if (!ocean.derivatives(cascade).empty()) {
+      recordLayerUpload(derivatives, layer, ocean.derivatives(cascade), cmd);
+   }
+}
+
+VkDeviceSize cpuStagingBytes(const CpuOcean &ocean, size_t cascade,
+                             const MyTextureData &displacement,
+                             const MyTextureData &derivatives) {
+   const std::vector<glm::vec4> &disp = ocean.displacement(cascade);
+   const std::vector<glm::vec4> &derv = ocean.derivatives(cascade);
+   VkDeviceSize bytes = disp.size() * texelBytes(displacement, 0, disp);
+   if (!derv.empty()) {
+      bytes += derv.size() * texelBytes(derivatives, 0, derv);
+   }
+   return bytes;
+}
+
+void packCpuOutputs(const CpuOcean &ocean, size_t cascade,
+                    const MyTextureData &displacement,
+                    const MyTextureData &derivatives, void *dst) {
+   const std::vector<glm::vec4> &disp = ocean.displacement(cascade);
+   const std::vector<glm::vec4> &derv = ocean.derivatives(cascade);
+   char *base = static_cast<char *>(dst);
+   VkDeviceSize bytes = texelBytes(displacement, 0, disp);
+   packTexels(disp, bytes, base);
+   if (derv.empty()) return;
+   packTexels(derv, texelBytes(derivatives, 0, derv),
+              base + disp.size() * bytes);
+}
+
+void recordCpuCopy(const CpuOcean &ocean, size_t cascade,
+                   MyTextureData &displacement, MyTextureData &derivatives,
+                   uint32_t layer, VkCommandBuffer cmd, VkBuffer staging,
+                   VkDeviceSize offset) {
+   const std::vector<glm::vec4> &disp = ocean.displacement(cascade);
+   const std::vector<glm::vec4> &derv = ocean.derivatives(cascade);
+   VkDeviceSize bytes = texelBytes(displacement, layer, disp);
+   recordCopy(displacement, layer, staging, offset, cmd);
+   if (derv.empty()) return;
+   texelBytes(derivatives, layer, derv);
+   recordCopy(derivatives, layer, staging, offset + disp.size() * bytes,
+              cmd);
+}
+
+}  // namespace lve
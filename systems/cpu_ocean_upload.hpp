@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "cpu_ocean.hpp"
+#include "gui_system.hpp"
+
+namespace lve {
+
+// Getting a CpuOcean's outputs into the simulation's textures. Both
+// upload a cascade to layer of the textures, between barriers against any
+// shader access, in fp16 or fp32 formats and the general layout. The
+// derivatives texture is ignored when the ocean has no derivatives.
+
+// Through the textures' own upload buffers, which they must have been
+// created with.
+void recordCpuUpload(const CpuOcean &ocean, size_t cascade,
+                     MyTextureData &displacement, MyTextureData &derivatives,
+                     uint32_t layer, VkCommandBuffer cmd);
+// Bytes of a cascade's outputs in the textures' formats.
+VkDeviceSize cpuStagingBytes(const CpuOcean &ocean, size_t cascade,
+                             const MyTextureData &displacement,
+                             const MyTextureData &derivatives);
+// Writes a cascade's outputs to dst in the textures' formats,
+// cpuStagingBytes of them.
+void packCpuOutputs(const CpuOcean &ocean, size_t cascade,
+                    const MyTextureData &displacement,
+                    const MyTextureData &derivatives, void *dst);
+// Copies outputs packCpuOutputs wrote at offset of staging to layer of
+// the textures. Only reads the ocean's sizes, so its next step may
+// already be running.
+void recordCpuCopy(const CpuOcean &ocean, size_t cascade,
+                   MyTextureData &displacement, MyTextureData &derivatives,
+                   uint32_t layer, VkCommandBuffer cmd, VkBuffer staging,
+                   VkDeviceSize offset);
+
+}  // namespace lve
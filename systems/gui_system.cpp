@@ -5,6 +5,7 @@
 #include <vulkan/vulkan_core.h>
 
 #include <cstdio>
+#include <string>
 
 #include "imgui/backends/imgui_impl_glfw.h"
 #include "imgui/backends/imgui_impl_vulkan.h"
@@ -52,9 +53,11 @@ void ImGuiGui::new_frame() {
 
 void ImGuiGui::update(lve::WaterMovementController &cameraControler,
                       bool &navegando, size_t &pipeline, glm::vec3 coord,
-                      float frameTime, MyTextureData *img[],
-                      SpectrumConfig params[], float &angle,
-                      float (&colors)[3][4]) {
+                      float frameTime,
+                      const std::vector<std::array<MyTextureData *, 5>> &img,
+                      VersionedSpectrumConfig &spectrum, float &angle,
+                      float (&colors)[3][4],
+                      SimulationSettings &simulation) {
    ImGui::Begin("Sensibilidad");
    ImGui::SliderFloat("Velocidad minima", &cameraControler.moveSpeedMin,
                       0.1f, cameraControler.moveSpeedMax);
@@ -83,84 +86,183 @@ void ImGuiGui::update(lve::WaterMovementController &cameraControler,
    ImGui::End();
    pipeline = pipeline_i;
 
-   ImGui::Begin("Init");
-   ImGui::Image((ImTextureID)img[0]->DS,
-                ImVec2(img[0]->Height, img[0]->Height));
+   ImGui::Begin("Simulacion");
+   ImGui::Checkbox("FFT fusionada", &simulation.fusedFFT);
+   ImGui::Checkbox("Evolucion por fasores", &simulation.phasorEvolution);
+   if (ImGui::Button("Reiniciar fase")) simulation.resetPhase = true;
+   ImGui::RadioButton("30 Hz", &simulation.tickRate, 30);
+   ImGui::SameLine();
+   ImGui::RadioButton("60 Hz", &simulation.tickRate, 60);
+   ImGui::Checkbox("Pausa", &simulation.paused);
+   ImGui::SliderFloat("Escala de tiempo", &simulation.timeScale, 0.f, 4.f);
+   for (size_t cascade = 0; cascade < simulation.cascadeInterval.size();
+        ++cascade) {
+      std::string label = "Intervalo cascada " + std::to_string(cascade);
+      ImGui::SliderInt(label.c_str(), &simulation.cascadeInterval[cascade],
+                       1, 8);
+   }
+   ImGui::Checkbox("Cascadas adaptativas", &simulation.adaptiveCascades);
+   ImGui::SliderFloat("Pixeles minimos por onda",
+                      &simulation.minCascadePixels, 0.5f, 32.f);
+   ImGui::Text("Precision: %s", simulation.precision);
+   ImGui::Checkbox("Comparar con fp32", &simulation.compareFp32);
+   if (simulation.hybridAvailable) {
+      ImGui::Checkbox("Reparto CPU/GPU automatico", &simulation.hybridAuto);
+      ImGui::BeginDisabled(simulation.hybridAuto);
+      for (size_t cascade = 0;
+           cascade < simulation.cascadeInterval.size(); ++cascade) {
+         std::string label = "CPU cascada " + std::to_string(cascade);
+         ImGui::CheckboxFlags(label.c_str(), &simulation.cpuCascades,
+                              1u << cascade);
+      }
+      ImGui::EndDisabled();
+   }
+   if (simulation.readbackAvailable) {
+      for (size_t cascade = 0;
+           cascade < simulation.cascadeInterval.size(); ++cascade) {
+         std::string label = "Lectura CPU cascada " + std::to_string(cascade);
+         ImGui::CheckboxFlags(label.c_str(), &simulation.readbackCascades,
+                              1u << cascade);
+      }
+      ImGui::Checkbox("Comparar con CPU", &simulation.compareCpu);
+      if (simulation.compareCpu && simulation.phasorEvolution) {
+         ImGui::TextDisabled("Solo sin evolucion por fasores");
+      }
+   }
+   ImGui::End();
+
+   // Profiler overlay, pinned to the top right corner.
+   const ImGuiViewport *viewport = ImGui::GetMainViewport();
+   ImGui::SetNextWindowPos(
+       ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - 10.f,
+              viewport->WorkPos.y + 10.f),
+       ImGuiCond_Always, ImVec2(1.f, 0.f));
+   ImGui::SetNextWindowBgAlpha(0.35f);
+   ImGui::Begin("Perfil", nullptr,
+                ImGuiWindowFlags_NoDecoration |
+                    ImGuiWindowFlags_AlwaysAutoResize |
+                    ImGuiWindowFlags_NoSavedSettings |
+                    ImGuiWindowFlags_NoFocusOnAppearing |
+                    ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove);
+   if (simulation.stepGpuMs >= 0) {
+      ImGui::Text("GPU por paso: %.3f ms", simulation.stepGpuMs);
+   } else {
+      ImGui::Text("GPU por paso: n/d");
+   }
+   if (simulation.hybridAvailable) {
+      if (simulation.cpuStepMs >= 0) {
+         ImGui::Text("CPU por paso: %.3f ms", simulation.cpuStepMs);
+      } else {
+         ImGui::Text("CPU por paso: n/d");
+      }
+   }
+   ImGui::Text("FFT por frame: %.2f de %.2f", simulation.fftPerFrame,
+               simulation.fftPerFrameFull);
+   for (size_t cascade = 0; cascade < simulation.cascadeInterval.size();
+        ++cascade) {
+      bool active = simulation.activeCascades & (1u << cascade);
+      bool cpu = simulation.cpuCascades & (1u << cascade);
+      ImGui::Text("Cascada %zu: %s", cascade,
+                  !active ? "inactiva" : cpu ? "activa (CPU)" : "activa");
+      if (simulation.compareFp32 &&
+          simulation.displacementRms[cascade] >= 0) {
+         float reference = simulation.displacementReferenceRms[cascade];
+         ImGui::Text("  error RMS %.2e m (%.3f%%), max %.2e m",
+                     simulation.displacementRms[cascade],
+                     reference > 0
+                         ? 100.f * simulation.displacementRms[cascade] /
+                               reference
+                         : 0.f,
+                     simulation.displacementMaxError[cascade]);
+      }
+      if (simulation.compareCpu && simulation.cpuRms[cascade] >= 0) {
+         ImGui::Text("  CPU: error RMS %.2e m, max %.2e m",
+                     simulation.cpuRms[cascade],
+                     simulation.cpuMaxError[cascade]);
+      }
+   }
    ImGui::End();
 
+   // One row of textures per cascade size group.
    ImGui::Begin("OnParamChange");
-   ImGui::Image((ImTextureID)img[1]->DS,
-                ImVec2(img[1]->Width, img[1]->Height));
-   ImGui::Image((ImTextureID)img[2]->DS,
-                ImVec2(img[2]->Width, img[2]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[6]->DS,
-                ImVec2(img[6]->Width, img[6]->Height));
-   ImGui::Image((ImTextureID)img[3]->DS,
-                ImVec2(img[3]->Width, img[3]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[7]->DS,
-                ImVec2(img[7]->Width, img[7]->Height));
-   ImGui::Image((ImTextureID)img[4]->DS,
-                ImVec2(img[4]->Width, img[4]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[8]->DS,
-                ImVec2(img[8]->Width, img[8]->Height));
-   ImGui::Image((ImTextureID)img[5]->DS,
-                ImVec2(img[5]->Width, img[5]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[9]->DS,
-                ImVec2(img[9]->Width, img[9]->Height));
+   for (const std::array<MyTextureData *, 5> &group : img) {
+      for (size_t layer = 0; layer < group[0]->LayerDS.size(); ++layer) {
+         ImGui::Image((ImTextureID)group[0]->LayerDS[layer],
+                      ImVec2(group[0]->Width, group[0]->Height));
+         ImGui::SameLine();
+         ImGui::Image((ImTextureID)group[1]->LayerDS[layer],
+                      ImVec2(group[1]->Width, group[1]->Height));
+         ImGui::SameLine();
+         ImGui::Image((ImTextureID)group[2]->LayerDS[layer],
+                      ImVec2(group[2]->Width, group[2]->Height));
+      }
+   }
    ImGui::End();
 
    ImGui::Begin("EveryFrame");
-   ImGui::Image((ImTextureID)img[10]->DS,
-                ImVec2(img[10]->Width, img[10]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[11]->DS,
-                ImVec2(img[11]->Width, img[11]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[12]->DS,
-                ImVec2(img[12]->Width, img[12]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[13]->DS,
-                ImVec2(img[13]->Width, img[13]->Height));
-   ImGui::Image((ImTextureID)img[14]->DS,
-                ImVec2(img[14]->Width, img[14]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[15]->DS,
-                ImVec2(img[15]->Width, img[15]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[16]->DS,
-                ImVec2(img[16]->Width, img[16]->Height));
-   ImGui::SameLine();
-   ImGui::Image((ImTextureID)img[17]->DS,
-                ImVec2(img[17]->Width, img[17]->Height));
+   for (const std::array<MyTextureData *, 5> &group : img) {
+      for (size_t i = 3; i < 5; ++i) {
+         for (size_t layer = 0; layer < group[i]->LayerDS.size();
+              ++layer) {
+            if (layer) ImGui::SameLine();
+            ImGui::Image((ImTextureID)group[i]->LayerDS[layer],
+                         ImVec2(group[i]->Width, group[i]->Height));
+         }
+      }
+   }
    ImGui::End();
 
-   ImGui::Begin("Params waves");
-   ImGui::SliderFloat("scale", &params[0].scale, 0.f, 1.f);
-   ImGui::InputFloat("windSpeed", &params[0].windSpeed);
-   ImGui::SliderAngle("windDirection", &params[0].windDirection, -180.f,
-                      180.f);
-   ImGui::InputFloat("fetch", &params[0].fetch);
-   ImGui::SliderFloat("spreadBlend", &params[0].spreadBlend, 0.f, 1.f);
-   ImGui::SliderFloat("swell", &params[0].swell, 0.f, 1.f);
-   ImGui::InputFloat("peakEnhancement", &params[0].peakEnhancement);
-   ImGui::InputFloat("shortWavesFade", &params[0].shortWavesFade);
+   // Sea states to switch between, as wind waves and swell. Switching
+   // back to one whose spectrum is still cached costs nothing.
+   static const struct {
+      const char *name;
+      SpectrumConfig config[2];
+   } seaStates[] = {
+       {"Calma",
+        {{0.5f, 0.25f, -0.5f, 50000.f, 1.f, 0.198f, 3.3f, 0.01f},
+         {0.f, 1.f, 0.f, 300000.f, 1.f, 1.f, 3.3f, 0.01f}}},
+       {"Moderado",
+        {{1.f, 0.5f, -0.5f, 100000.f, 1.f, 0.198f, 3.3f, 0.01f},
+         {0.f, 1.f, 0.f, 300000.f, 1.f, 1.f, 3.3f, 0.01f}}},
+       {"Tormenta",
+        {{1.f, 2.f, -0.5f, 300000.f, 0.5f, 0.1f, 5.f, 0.01f},
+         {0.3f, 1.f, 0.f, 300000.f, 1.f, 1.f, 3.3f, 0.01f}}},
+       {"Mar de fondo",
+        {{0.3f, 0.5f, -0.5f, 100000.f, 1.f, 0.198f, 3.3f, 0.01f},
+         {1.f, 1.f, 0.f, 300000.f, 1.f, 1.f, 3.3f, 0.01f}}},
+   };
+   ImGui::Begin("Estado del mar");
+   for (const auto &state : seaStates) {
+      if (ImGui::Button(state.name)) {
+         spectrum.config[0] = state.config[0];
+         spectrum.config[1] = state.config[1];
+         ++spectrum.version;
+      }
+   }
+   ImGui::Checkbox("Transicion gradual", &simulation.blendSpectra);
+   ImGui::SliderFloat("Duracion (s)", &simulation.blendSeconds, 1.f, 300.f);
+   ImGui::ProgressBar(simulation.spectrumBlend);
    ImGui::End();
 
-   ImGui::Begin("Params swell");
-   ImGui::SliderFloat("scale", &params[1].scale, 0.f, 1.f);
-   ImGui::InputFloat("windSpeed", &params[1].windSpeed);
-   ImGui::SliderAngle("windDirection", &params[1].windDirection, -180.f,
-                      180.f);
-   ImGui::InputFloat("fetch", &params[1].fetch);
-   ImGui::SliderFloat("spreadBlend", &params[1].spreadBlend, 0.f, 1.f);
-   ImGui::SliderFloat("swell", &params[1].swell, 0.f, 1.f);
-   ImGui::InputFloat("peakEnhancement", &params[1].peakEnhancement);
-   ImGui::InputFloat("shortWavesFade", &params[1].shortWavesFade);
-   ImGui::End();
+   const char *spectrumWindows[] = {"Params waves", "Params swell"};
+   for (size_t s = 0; s < 2; ++s) {
+      SpectrumConfig &params = spectrum.config[s];
+      bool edited = false;
+      ImGui::Begin(spectrumWindows[s]);
+      edited |= ImGui::SliderFloat("scale", &params.scale, 0.f, 1.f);
+      edited |= ImGui::InputFloat("windSpeed", &params.windSpeed);
+      edited |= ImGui::SliderAngle("windDirection", &params.windDirection,
+                                   -180.f, 180.f);
+      edited |= ImGui::InputFloat("fetch", &params.fetch);
+      edited |=
+          ImGui::SliderFloat("spreadBlend", &params.spreadBlend, 0.f, 1.f);
+      edited |= ImGui::SliderFloat("swell", &params.swell, 0.f, 1.f);
+      edited |=
+          ImGui::InputFloat("peakEnhancement", &params.peakEnhancement);
+      edited |= ImGui::InputFloat("shortWavesFade", &params.shortWavesFade);
+      ImGui::End();
+      if (edited) ++spectrum.version;
+   }
 
    ImGui::Begin("Colors");
    ImGui::ColorPicker4("Sun", colors[0]);
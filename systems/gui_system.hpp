@@ -1,7 +1,10 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <cstring>
 #include <cwchar>
+#include <vector>
 
 #include "../lve/lve_device.hpp"
 #include "../lve/lve_renderer.hpp"
@@ -18,24 +21,110 @@ typedef struct {
    glm::float32 shortWavesFade;
 } SpectrumConfig;
 
+// The wind waves and swell spectra as edited. version goes up with every
+// edit, so a change shows without comparing the fields.
+typedef struct {
+   SpectrumConfig config[2];
+   uint64_t version;
+} VersionedSpectrumConfig;
+
+// Runtime switches of the ocean simulation.
+typedef struct {
+   // Fold inv_perm and texture_merger into the FFT instead of running
+   // them as their own passes.
+   bool fusedFFT;
+   // Advance the waves by rotating a stored phasor each tick instead of
+   // evaluating exp(i omega t).
+   bool phasorEvolution;
+   // Restart the phasors from exp(i 0) on the next step.
+   bool resetPhase;
+   // Simulation steps per second, independent of the frame rate.
+   int tickRate;
+   bool paused;
+   // Simulated seconds per real second.
+   float timeScale;
+   // Steps between updates of each cascade, 1 to 8. The cascades in
+   // between are interpolated.
+   std::vector<int> cascadeInterval;
+   // Drop the cascades whose waves are too small to see from the
+   // camera height, from both the simulation and the water shaders.
+   bool adaptiveCascades;
+   // Smallest on screen size, in pixels, of a cascade's longest waves.
+   float minCascadePixels;
+   // Shown in the profiler overlay: cascade FFTs run per frame and what
+   // updating every cascade on every step would run, both averaged, the
+   // averaged GPU time of a step (negative without timestamps) and a
+   // bit set for each cascade currently active.
+   float fftPerFrame;
+   float fftPerFrameFull;
+   float stepGpuMs;
+   uint32_t activeCascades;
+   // Storage precision picked at startup, shown in the GUI.
+   const char *precision;
+   // Check every updated cascade against an fp32 reference. The RMS and
+   // largest error of the displacement, in meters, and the RMS of the
+   // reference itself, per cascade. Negative until first measured.
+   bool compareFp32;
+   std::vector<float> displacementRms;
+   std::vector<float> displacementMaxError;
+   std::vector<float> displacementReferenceRms;
+   // Blend from one sea state to the next over blendSeconds instead of
+   // switching at once. spectrumBlend is how far the last one got, 0 to
+   // 1, shown in the GUI.
+   bool blendSpectra;
+   float blendSeconds;
+   float spectrumBlend;
+   // Hybrid split, only with --hybrid: the cascades with a bit set in
+   // cpuCascades are simulated on the CPU. hybridAuto picks them from
+   // the step timings, cpuStepMs is the averaged time of a CPU step
+   // (negative before the first).
+   bool hybridAvailable;
+   bool hybridAuto;
+   uint32_t cpuCascades;
+   float cpuStepMs;
+   // Cascades whose displacement is read back to the CPU, only when the
+   // readback is on.
+   bool readbackAvailable;
+   uint32_t readbackCascades;
+   // Check the cascades read back against CpuOcean, while phasor
+   // evolution is off. The RMS and largest error of the displacement, in
+   // meters, per cascade. Negative until first measured.
+   bool compareCpu;
+   std::vector<float> cpuRms;
+   std::vector<float> cpuMaxError;
+} SimulationSettings;
+
 struct MyTextureData {
    VkDescriptorSet
        DS;  // Descriptor set: this is what you'll pass to Image()
    int Width;
    int Height;
    int Channels;
+   // 0 for a plain 2D texture, otherwise the number of layers of a 2D
+   // array texture. ImageView then spans every layer and LayerDS holds
+   // one ImGui descriptor per layer.
+   int Layers;
+   VkFormat Format;
+   std::vector<VkDescriptorSet> LayerDS;
 
    // Need to keep track of these to properly cleanup
    VkImageView ImageView;
    VkImage Image;
    VkDeviceMemory ImageMemory;
+   std::vector<VkImageView> LayerViews;
    VkSampler Sampler;
-   VkBuffer UploadBuffer;
-   VkDeviceMemory UploadBufferMemory;
+   // Only allocated for textures created with upload, the rest start
+   // cleared to zero. Holds every layer, one after the other.
+   VkBuffer UploadBuffer = VK_NULL_HANDLE;
+   VkDeviceMemory UploadBufferMemory = VK_NULL_HANDLE;
    lve::LveDevice &device;
 
+   // shared images are used concurrently by the graphics and compute
+   // queue families, the rest are owned by one family at a time.
    MyTextureData(size_t width, size_t height, size_t channels,
-                 lve::LveDevice &device, VkFormat format);
+                 lve::LveDevice &device, VkFormat format,
+                 size_t layers = 0, bool shared = false,
+                 bool upload = false);
    ~MyTextureData();
 };
 
@@ -61,8 +150,9 @@ class ImGuiGui {
    void new_frame();
    void update(lve::WaterMovementController &cameraControler,
                bool &navegando, size_t &pipeline, glm::vec3 coord,
-               float frameTime, MyTextureData *img[],
-               SpectrumConfig params[], float &angle,
-               float (&colors)[3][4]);
+               float frameTime,
+               const std::vector<std::array<MyTextureData *, 5>> &img,
+               VersionedSpectrumConfig &spectrum, float &angle,
+               float (&colors)[3][4], SimulationSettings &simulation);
    void render(VkCommandBuffer command_buffer);
 };
@@ -36,6 +36,10 @@ bool LoadTextureFromFile(const char* filename, MyTextureData* tex_data,
                  tex_data->Channels);
 
    if (image_data == NULL) return false;
+   if (tex_data->UploadBufferMemory == VK_NULL_HANDLE) {
+      stbi_image_free(image_data);
+      return false;
+   }
 
    // Calculate allocation size (in number of bytes)
    size_t image_size =
@@ -66,8 +70,16 @@ bool LoadTextureFromFile(const char* filename, MyTextureData* tex_data,
 }
 
 MyTextureData::MyTextureData(size_t width, size_t height, size_t channels,
-                             lve::LveDevice& device, VkFormat format)
-    : Width(width), Height(height), Channels(channels), device(device) {
+                             lve::LveDevice& device, VkFormat format,
+                             size_t layers, bool shared, bool upload)
+    : Width(width),
+      Height(height),
+      Channels(channels),
+      Layers(layers),
+      Format(format),
+      device(device) {
+   uint32_t layer_count = layers ? layers : 1;
+
    // Calculate allocation size (in number of bytes)
    size_t image_size = this->Width * this->Height * this->Channels * 2;
 
@@ -83,13 +95,22 @@ MyTextureData::MyTextureData(size_t width, size_t height, size_t channels,
       info.extent.height = this->Height;
       info.extent.depth = 1;
       info.mipLevels = 1;
-      info.arrayLayers = 1;
+      info.arrayLayers = layer_count;
       info.samples = VK_SAMPLE_COUNT_1_BIT;
       info.tiling = VK_IMAGE_TILING_OPTIMAL;
       info.usage = VK_IMAGE_USAGE_SAMPLED_BIT |
                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
                    VK_IMAGE_USAGE_STORAGE_BIT;
       info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      lve::QueueFamilyIndices families =
+          device.findPhysicalQueueFamilies();
+      uint32_t family_indices[] = {families.graphicsFamily,
+                                   families.computeFamily};
+      if (shared && families.hasDedicatedCompute()) {
+         info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+         info.queueFamilyIndexCount = 2;
+         info.pQueueFamilyIndices = family_indices;
+      }
       info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
       err = vkCreateImage(device.device(), &info, nullptr, &this->Image);
       check_vk_result(err);
@@ -113,22 +134,43 @@ MyTextureData::MyTextureData(size_t width, size_t height, size_t channels,
       VkImageViewCreateInfo info = {};
       info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
       info.image = this->Image;
-      info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      info.viewType =
+          layers ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
       info.format = format;
       info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
       info.subresourceRange.levelCount = 1;
-      info.subresourceRange.layerCount = 1;
+      info.subresourceRange.layerCount = layer_count;
       err = vkCreateImageView(device.device(), &info, nullptr,
                               &this->ImageView);
       check_vk_result(err);
+
+      // ImGui can only sample plain 2D views
+      info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      info.subresourceRange.layerCount = 1;
+      for (uint32_t layer = 0; layers && layer < layer_count; ++layer) {
+         info.subresourceRange.baseArrayLayer = layer;
+         VkImageView view;
+         err = vkCreateImageView(device.device(), &info, nullptr, &view);
+         check_vk_result(err);
+         this->LayerViews.push_back(view);
+      }
    }
 
-   // Create Sampler
+   // Create Sampler, nearest for formats that can not be filtered
+   // (fp32 ones on many devices)
    {
+      VkFormatProperties format_properties;
+      vkGetPhysicalDeviceFormatProperties(device.physical_device(), format,
+                                          &format_properties);
+      VkFilter filter =
+          (format_properties.optimalTilingFeatures &
+           VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+              ? VK_FILTER_LINEAR
+              : VK_FILTER_NEAREST;
       VkSamplerCreateInfo sampler_info{};
       sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-      sampler_info.magFilter = VK_FILTER_LINEAR;
-      sampler_info.minFilter = VK_FILTER_LINEAR;
+      sampler_info.magFilter = filter;
+      sampler_info.minFilter = filter;
       sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
       sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
       sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
@@ -142,14 +184,22 @@ MyTextureData::MyTextureData(size_t width, size_t height, size_t channels,
    }
 
    // Create Descriptor Set using ImGUI's implementation
-   this->DS = ImGui_ImplVulkan_AddTexture(this->Sampler, this->ImageView,
-                                          VK_IMAGE_LAYOUT_GENERAL);
+   if (layers) {
+      for (VkImageView view : this->LayerViews) {
+         this->LayerDS.push_back(ImGui_ImplVulkan_AddTexture(
+             this->Sampler, view, VK_IMAGE_LAYOUT_GENERAL));
+      }
+   } else {
+      this->LayerDS.push_back(ImGui_ImplVulkan_AddTexture(
+          this->Sampler, this->ImageView, VK_IMAGE_LAYOUT_GENERAL));
+   }
+   this->DS = this->LayerDS[0];
 
    // Create Upload Buffer
-   {
+   if (upload) {
       VkBufferCreateInfo buffer_info = {};
       buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      buffer_info.size = image_size;
+      buffer_info.size = image_size * layer_count;
       buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
       buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
       err = vkCreateBuffer(device.device(), &buffer_info, nullptr,
@@ -195,7 +245,7 @@ MyTextureData::MyTextureData(size_t width, size_t height, size_t channels,
       check_vk_result(err);
    }
 
-   // Copy to Image
+   // Clear every layer, an upload buffer is only filled later
    {
       VkImageMemoryBarrier copy_barrier[1] = {};
       copy_barrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -208,20 +258,19 @@ MyTextureData::MyTextureData(size_t width, size_t height, size_t channels,
       copy_barrier[0].subresourceRange.aspectMask =
           VK_IMAGE_ASPECT_COLOR_BIT;
       copy_barrier[0].subresourceRange.levelCount = 1;
-      copy_barrier[0].subresourceRange.layerCount = 1;
+      copy_barrier[0].subresourceRange.layerCount = layer_count;
       vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_HOST_BIT,
                            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
                            NULL, 1, copy_barrier);
 
-      VkBufferImageCopy region = {};
-      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-      region.imageSubresource.layerCount = 1;
-      region.imageExtent.width = this->Width;
-      region.imageExtent.height = this->Height;
-      region.imageExtent.depth = 1;
-      vkCmdCopyBufferToImage(
-          command_buffer, this->UploadBuffer, this->Image,
-          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+      VkClearColorValue zero = {};
+      VkImageSubresourceRange range = {};
+      range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      range.levelCount = 1;
+      range.layerCount = layer_count;
+      vkCmdClearColorImage(command_buffer, this->Image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero, 1,
+                           &range);
 
       VkImageMemoryBarrier use_barrier[1] = {};
       use_barrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -235,7 +284,7 @@ MyTextureData::MyTextureData(size_t width, size_t height, size_t channels,
       use_barrier[0].subresourceRange.aspectMask =
           VK_IMAGE_ASPECT_COLOR_BIT;
       use_barrier[0].subresourceRange.levelCount = 1;
-      use_barrier[0].subresourceRange.layerCount = 1;
+      use_barrier[0].subresourceRange.layerCount = layer_count;
       vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
                            NULL, 0, NULL, 1, use_barrier);
@@ -262,8 +311,13 @@ MyTextureData::~MyTextureData() {
    vkFreeMemory(this->device.device(), this->UploadBufferMemory, nullptr);
    vkDestroyBuffer(this->device.device(), this->UploadBuffer, nullptr);
    vkDestroySampler(this->device.device(), this->Sampler, nullptr);
+   for (VkImageView view : this->LayerViews) {
+      vkDestroyImageView(this->device.device(), view, nullptr);
+   }
    vkDestroyImageView(this->device.device(), this->ImageView, nullptr);
    vkDestroyImage(this->device.device(), this->Image, nullptr);
    vkFreeMemory(this->device.device(), this->ImageMemory, nullptr);
-   ImGui_ImplVulkan_RemoveTexture(this->DS);
+   for (VkDescriptorSet set : this->LayerDS) {
+      ImGui_ImplVulkan_RemoveTexture(set);
+   }
 }
@@ -0,0 +1,99 @@
+#include "ocean_readback.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace lve {
+
+glm::vec4 OceanSnapshot::displacement(glm::vec2 pos) const {
+   glm::vec4 sum(0.f);
+   for (uint32_t c = 0; c < data.size(); ++c) {
+      if ((cascades & (1u << c)) == 0) continue;
+      const Cascade &cascade = data[c];
+      // Texel i is centered on uv (i + 0.5) / size, as with texture().
+      glm::vec2 t = pos / cascade.lengthScale * float(cascade.size) - 0.5f;
+      glm::vec2 cell = glm::floor(t);
+      glm::vec2 f = t - cell;
+      // Sizes are powers of two, so the mask wraps negatives too.
+      uint32_t mask = cascade.size - 1;
+      uint32_t x0 = int32_t(cell.x) & mask;
+      uint32_t y0 = int32_t(cell.y) & mask;
+      uint32_t x1 = (x0 + 1) & mask;
+      uint32_t y1 = (y0 + 1) & mask;
+      const glm::vec4 *row0 = &cascade.texels[y0 * cascade.size];
+      const glm::vec4 *row1 = &cascade.texels[y1 * cascade.size];
+      sum += glm::mix(glm::mix(row0[x0], row0[x1], f.x),
+                      glm::mix(row1[x0], row1[x1], f.x), f.y);
+   }
+   return sum;
+}
+
+float OceanSnapshot::height(glm::vec2 pos) const {
+   glm::vec2 plane = pos;
+   for (int i = 0; i < 4; ++i) {
+      glm::vec4 d = displacement(plane);
+      plane = pos - glm::vec2(d.x, d.z);
+   }
+   return displacement(plane).y;
+}
+
+OceanReadback::Handle::~Handle() {
+   if (entry) entry->readers.fetch_sub(1, std::memory_order_release);
+}
+
+OceanReadback::Handle::Handle(Handle &&other) noexcept
+    : entry(other.entry) {
+   other.entry = nullptr;
+}
+
+OceanReadback::Handle &OceanReadback::Handle::operator=(
+    Handle &&other) noexcept {
+   if (this != &other) {
+      if (entry) entry->readers.fetch_sub(1, std::memory_order_release);
+      entry = other.entry;
+      other.entry = nullptr;
+   }
+   return *this;
+}
+
+OceanReadback::OceanReadback(size_t capacity)
+    : entries(new Entry[capacity]), capacity(capacity) {
+   if (capacity < 2) {
+      throw std::runtime_error("ocean readback needs two snapshots");
+   }
+}
+
+OceanReadback::Handle OceanReadback::latest() const {
+   for (;;) {
+      Entry *entry = current.load();
+      if (!entry) return {};
+      // Once counted, the writer skips the entry unless it was already
+      // replaced, which the second load catches.
+      entry->readers.fetch_add(1);
+      if (current.load() == entry) return Handle(entry);
+      entry->readers.fetch_sub(1, std::memory_order_release);
+   }
+}
+
+OceanSnapshot *OceanReadback::writable() {
+   Entry *front = current.load();
+   for (size_t i = 0; i < capacity; ++i) {
+      Entry *entry = &entries[i];
+      if (entry != front && entry->readers.load() == 0) {
+         writing = entry;
+         return &entry->snapshot;
+      }
+   }
+   return nullptr;
+}
+
+void OceanReadback::publish(OceanSnapshot *snapshot) {
+   if (!writing || snapshot != &writing->snapshot) {
+      throw std::runtime_error("published snapshot was not writable");
+   }
+   current.store(writing);
+   writing = nullptr;
+}
+
+}  // namespace lve
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace lve {
+
+// The displacement of the cascades read back from one simulation step,
+// in world units, as the water shaders add it up.
+struct OceanSnapshot {
+   struct Cascade {
+      float lengthScale;
+      // Texels per side, the cascade's size over the readback stride.
+      uint32_t size;
+      // xyz displacement and turbulence in w, row major.
+      std::vector<glm::vec4> texels;
+   };
+
+   uint64_t tick;
+   double time;
+   // A bit set for each cascade of data read back from the step.
+   uint32_t cascades;
+   std::vector<Cascade> data;
+
+   // The displacement of the water at pos of the undisplaced plane,
+   // each cascade sampled bilinearly and repeated as the shaders do.
+   glm::vec4 displacement(glm::vec2 pos) const;
+   // The height of the surface above pos of the world, undoing the
+   // horizontal displacement by a few fixed point iterations.
+   float height(glm::vec2 pos) const;
+};
+
+// Hands the latest snapshot from the render loop to any thread, without
+// locks on either side. Readers hold on to one through a Handle; the
+// writer fills a snapshot no reader holds and publishes it, or drops it
+// when they hold every one.
+class OceanReadback {
+  private:
+   struct Entry {
+      OceanSnapshot snapshot;
+      std::atomic<uint32_t> readers{0};
+   };
+
+  public:
+   class Handle {
+     public:
+      Handle() = default;
+      ~Handle();
+      Handle(Handle &&other) noexcept;
+      Handle &operator=(Handle &&other) noexcept;
+      Handle(const Handle &) = delete;
+      Handle &operator=(const Handle &) = delete;
+
+      const OceanSnapshot *get() const {
+         return entry ? &entry->snapshot : nullptr;
+      }
+      const OceanSnapshot *operator->() const {
+         return get();
+      }
+      explicit operator bool() const {
+         return entry != nullptr;
+      }
+
+     private:
+      friend class OceanReadback;
+      explicit Handle(Entry *entry) : entry(entry) {}
+      Entry *entry = nullptr;
+   };
+
+   // capacity bounds the snapshots readers can hold at once, plus the
+   // one being written.
+   explicit OceanReadback(size_t capacity = 4);
+
+   OceanReadback(const OceanReadback &) = delete;
+   OceanReadback &operator=(const OceanReadback &) = delete;
+
+   // An empty handle until the first snapshot is published.
+   Handle latest() const;
+
+   // Writer side, from a single thread. writable returns nullptr when
+   // readers hold every snapshot.
+   OceanSnapshot *writable();
+   void publish(OceanSnapshot *snapshot);
+
+  private:
+   std::unique_ptr<Entry[]> entries;
+   size_t capacity;
+   std::atomic<Entry *> current{nullptr};
+   Entry *writing = nullptr;
+};
+
+}  // namespace lve
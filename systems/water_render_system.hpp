@@ -31,6 +31,10 @@ class WaterRenderSystem {
    WaterRenderSystem &operator=(const WaterRenderSystem &) = delete;
 
    void renderTerrain(FrameInfo &frameInfo, PipeLineType pipeline);
+   // Selects the displacement set used by the next renderTerrain calls.
+   void setDisplacementDescriptor(VkDescriptorSet dispDesc) {
+      displacementDesciptor = dispDesc;
+   }
 
   private:
    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout,